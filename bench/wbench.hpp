@@ -0,0 +1,77 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wbench.hpp
+ * @author Haoran Luo
+ * @brief wdedup Benchmark Utilities
+ *
+ * This file defines the helpers shared by the benchmark tools, like
+ * the pseudo random number generator and the parsing of arguments.
+ */
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace wdedup {
+
+/// The generator of pseudo random numbers, in splitmix64.
+struct SplitMix {
+	uint64_t state;
+	SplitMix(uint64_t seed) noexcept: state(seed) {}
+	uint64_t operator()() noexcept {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	/// Retrieve a uniform double in [0, 1).
+	double uniform() noexcept { 
+		return ((*this)() >> 11) * (1.0 / 9007199254740992.0); 
+	}
+};
+
+/// Parse the size with optional k, m or g suffix.
+inline uint64_t parseSize(const std::string& str) {
+	uint64_t value = strtoull(str.c_str(), nullptr, 10);
+	switch(str.empty()? '\0' : str.back()) {
+	case 'g': case 'G': value *= 1024;
+	case 'm': case 'M': value *= 1024;
+	case 'k': case 'K': value *= 1024;
+	default: break;
+	}
+	return value;
+}
+
+/// Split the comma separated list.
+inline std::vector<std::string> split(const std::string& list) {
+	std::vector<std::string> result;
+	std::stringstream in(list);
+	std::string item;
+	while(std::getline(in, item, ',')) if(item != "") result.push_back(item);
+	return result;
+}
+
+} // namespace wdedup
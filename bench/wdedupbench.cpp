@@ -0,0 +1,235 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wdedupbench.cpp
+ * @author Haoran Luo
+ * @brief wdedup Deduplication Engine Microbenchmark
+ *
+ * This file benchmarks the deduplication engines that profile the
+ * segments (wdedup::TreeDedup and wdedup::SortDedup). Each engine is
+ * filled with tokens of a distribution until either the working 
+ * memory is full or the tokens are exhausted, then it is poured into
+ * an output discarding the items. The throughput of inserting and 
+ * pouring, the bytes of working memory per distinct word, and the
+ * cache misses (when hardware counters are available) are measured.
+ *
+ * The tokens are generated before measuring, from a vocabulary whose
+ * words are derived from their indices, in distributions of:
+ * - zipf: Zipfian (s = 1) over the vocabulary, like natural text.
+ * - uniform: uniform over the vocabulary.
+ * - long: uniform over a vocabulary of 64 to 256 bytes long words,
+ *   which spill into the string pool.
+ * - unique: every token is distinct.
+ *
+ * Each measurement is printed as a line of JSON object, so that the
+ * results could be collected and compared by scripts.
+ *
+ * Usage: wdedup-bench [TOKENS [WORKMEM...]], where TOKENS defaults to
+ * 4m, and WORKMEM defaults to 1m 16m 64m. The tokens are generated up
+ * to twice the largest working memory, which is enough to fill it
+ * unless the words repeat.
+ */
+#include "impl/wtreededup.hpp"
+#include "impl/wsortdedup.hpp"
+#include "impl/wperf.hpp"
+#include "wbench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+
+namespace {
+
+using wdedup::SplitMix;
+using wdedup::parseSize;
+
+/// Derive the word of the index, whose length is within the range.
+/// The index is encoded into the last digits letters of the word, so
+/// the words are distinct as long as the indices are below 26^digits.
+std::string vocabulary(uint64_t index, size_t digits, 
+	size_t minLen, size_t maxLen) {
+	SplitMix random(index * 0x2545f4914f6cdd1dull + 1);
+	minLen = std::max(minLen, digits);
+	maxLen = std::max(maxLen, minLen);
+	size_t length = minLen + random() % (maxLen - minLen + 1);
+	std::string word(length, 'a');
+	for(size_t i = 0; i < length; ++ i) word[i] = 'a' + random() % 26;
+
+	// Encode the index into the tail so that words are distinct.
+	for(size_t i = 0; i < digits; ++ i, index /= 26)
+		word[length - i - 1] = 'a' + index % 26;
+	return word;
+}
+
+/// The tokens of a distribution, stored consecutively.
+struct Tokens {
+	std::string name;
+	std::vector<char> data;
+	std::vector<std::pair<size_t, size_t>> spans;
+};
+
+/// Generate the tokens of the distribution, until there're count
+/// tokens or the tokens take specified bytes.
+Tokens generate(const std::string& name, size_t count, size_t bytes) {
+	static const uint64_t words = 1 << 20;
+	Tokens tokens; tokens.name = name;
+	SplitMix random(42);
+
+	// The digits to encode every index, including the unique ones.
+	size_t digits = 1;
+	for(uint64_t v = words + count; v >= 26; v /= 26) ++ digits;
+
+	// The cumulative distribution of Zipfian, sampled by bisection.
+	std::vector<double> cdf;
+	if(name == "zipf") {
+		cdf.resize(words);
+		double sum = 0.0;
+		for(uint64_t i = 0; i < words; ++ i) cdf[i] = (sum += 1.0 / (i + 1));
+		for(uint64_t i = 0; i < words; ++ i) cdf[i] /= sum;
+	}
+
+	for(size_t i = 0; i < count && tokens.data.size() < bytes; ++ i) {
+		std::string word;
+		if(name == "zipf") {
+			double u = (random() >> 11) * (1.0 / 9007199254740992.0);
+			uint64_t index = std::lower_bound(cdf.begin(), cdf.end(), u) 
+				- cdf.begin();
+			word = vocabulary(std::min(index, words - 1), digits, 3, 12);
+		} else if(name == "uniform") 
+			word = vocabulary(random() % words, digits, 3, 12);
+		else if(name == "long") 
+			word = vocabulary(random() % words, digits, 64, 256);
+		else word = vocabulary(words + i, digits, 6, 14);
+		tokens.spans.push_back(std::make_pair(tokens.data.size(), word.size()));
+		tokens.data.insert(tokens.data.end(), word.begin(), word.end());
+		tokens.data.push_back(' ');
+	}
+	return tokens;
+}
+
+/// The profile output counting and discarding the items.
+struct DiscardOutput : public wdedup::ProfileOutput {
+	size_t& items;
+	DiscardOutput(size_t& items) noexcept: items(items) {}
+	virtual void push(wdedup::ProfileItem) throw (wdedup::Error) override {
+		++ items;
+	}
+	virtual size_t close() throw (wdedup::Error) override { return 0; }
+};
+
+/// Retrieve the seconds elapsed since the specified time.
+double since(std::chrono::steady_clock::time_point start) noexcept {
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+/// Benchmark an engine on the tokens with specified working memory.
+template<typename Dedup> void bench(const char* engine, const Tokens& tokens,
+	size_t workmem, const wdedup::PerfCounters& perf) {
+	// The working memory is touched before measuring, so that page
+	// faults are not counted as inserting.
+	void* memory = mmap(nullptr, workmem, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED) { perror("mmap"); exit(1); }
+	memset(memory, 0, workmem);
+
+	// Insert the tokens until the working memory is full.
+	Dedup dedup(memory, workmem);
+	size_t inserted = 0;
+	wdedup::PerfSample insertStart = perf.sample();
+	auto start = std::chrono::steady_clock::now();
+	for(; inserted < tokens.spans.size(); ++ inserted) {
+		const std::pair<size_t, size_t>& span = tokens.spans[inserted];
+		if(!dedup.insert(&tokens.data[span.first], span.second, span.first))
+			break;
+	}
+	double insertSeconds = since(start);
+	wdedup::PerfSample insertCounts = perf.sample() - insertStart;
+
+	// Pour the engine into the discarding output.
+	size_t items = 0;
+	wdedup::PerfSample pourStart = perf.sample();
+	start = std::chrono::steady_clock::now();
+	Dedup::pour(std::move(dedup), std::unique_ptr<wdedup::ProfileOutput>(
+		new DiscardOutput(items)));
+	double pourSeconds = since(start);
+	wdedup::PerfSample pourCounts = perf.sample() - pourStart;
+	munmap(memory, workmem);
+
+	// Print out the measurement, where the bytes per distinct word is
+	// only meaningful when the working memory is full.
+	size_t misses = (size_t)wdedup::PerfEvent::cacheMisses;
+	bool full = inserted < tokens.spans.size();
+	std::cout << "{\"engine\": \"" << engine << "\""
+		<< ", \"distribution\": \"" << tokens.name << "\""
+		<< ", \"workmem\": " << workmem
+		<< ", \"tokens\": " << inserted
+		<< ", \"distinct\": " << items
+		<< ", \"full\": " << (full? "true" : "false")
+		<< ", \"insertSeconds\": " << insertSeconds
+		<< ", \"insertTokensPerSecond\": " << inserted / insertSeconds
+		<< ", \"pourSeconds\": " << pourSeconds
+		<< ", \"pourItemsPerSecond\": " << items / pourSeconds
+		<< ", \"bytesPerDistinctWord\": ";
+	if(full && items > 0) std::cout << (double)workmem / items;
+	else std::cout << "null";
+	std::cout << ", \"insertCacheMissesPerToken\": ";
+	if(insertCounts.counted[misses] && inserted > 0) 
+		std::cout << insertCounts.values[misses] / inserted;
+	else std::cout << "null";
+	std::cout << ", \"pourCacheMissesPerItem\": ";
+	if(pourCounts.counted[misses] && items > 0) 
+		std::cout << pourCounts.values[misses] / items;
+	else std::cout << "null";
+	std::cout << "}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1? parseSize(argv[1]) : 4 << 20;
+	std::vector<size_t> workmems;
+	for(int i = 2; i < argc; ++ i) workmems.push_back(parseSize(argv[i]));
+	if(workmems.empty()) workmems = { 1 << 20, 16 << 20, 64 << 20 };
+
+	// The hardware counters are opened on the benchmarking thread.
+	wdedup::PerfCounters perf;
+	if(!perf.available()) std::cerr << "Hardware counters unavailable: " 
+		<< perf.unavailable() << std::endl;
+
+	for(const char* name : { "zipf", "uniform", "long", "unique" }) {
+		Tokens tokens = generate(name, count, 2 * *std::max_element(
+			workmems.begin(), workmems.end()));
+		for(size_t i = 0; i < workmems.size(); ++ i) {
+			bench<wdedup::TreeDedup>("tree", tokens, workmems[i], perf);
+			bench<wdedup::SortDedup>("sort", tokens, workmems[i], perf);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,319 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wdedupe2e.cpp
+ * @author Haoran Luo
+ * @brief wdedup End-to-End Benchmark Driver
+ *
+ * This file drives the whole pipeline (wprof, wmerge and wfind) of
+ * wdedup on the corpora generated by wdedup-gen, over the matrix of
+ * binaries, working memory sizes, synchronization distances and 
+ * numbers of threads. Each run starts from an empty working directory,
+ * and the wall time, the I/O volume (from the statistics report of
+ * the run) and the peak resident set size are measured, while the 
+ * printed word is checked against the expected answer of the corpus.
+ *
+ * The deduplication engine is selected when wdedup is built, so the
+ * engines are compared by passing the binaries built with each of them,
+ * like "--binary tree=build-tree/wdedup --binary sort=build-sort/wdedup".
+ *
+ * Each measurement is printed as a line of JSON object, identified by
+ * its "key", so that the output could be stored as the baseline. When
+ * a baseline is specified, the measurements are compared against the
+ * ones of the same key, and any of them exceeding the baseline beyond
+ * the tolerance is flagged as regression, so is any incorrect answer.
+ * The driver exits with 1 if there's any regression.
+ */
+#include "wbench.hpp"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using wdedup::split;
+
+/// The result of running a child process.
+struct Run {
+	/// The wall time of the process.
+	double wallSeconds;
+
+	/// The peak resident set size of the process.
+	uint64_t peakRssBytes;
+
+	/// The exit status of the process.
+	int status;
+};
+
+/// Run the command with its standard output and error redirected to
+/// the specified files, and wait for it to complete.
+Run run(const std::vector<std::string>& command, 
+	const std::string& out, const std::string& err) {
+	std::vector<char*> argv;
+	for(const std::string& arg : command) argv.push_back((char*)arg.c_str());
+	argv.push_back(nullptr);
+
+	auto start = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if(pid < 0) throw std::runtime_error(std::string("fork: ") + strerror(errno));
+	if(pid == 0) {
+		int fdout = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		int fderr = open(err.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fdout < 0 || fderr < 0) _exit(127);
+		dup2(fdout, STDOUT_FILENO); dup2(fderr, STDERR_FILENO);
+		execvp(argv[0], argv.data());
+		_exit(127);
+	}
+
+	// The resource usage is collected for the child only.
+	Run result; struct rusage usage;
+	while(wait4(pid, &result.status, 0, &usage) < 0) {
+		if(errno != EINTR) throw std::runtime_error(
+			std::string("wait4: ") + strerror(errno));
+	}
+	result.wallSeconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	result.peakRssBytes = (uint64_t)usage.ru_maxrss * 1024;
+	if(!WIFEXITED(result.status) || WEXITSTATUS(result.status) == 127) 
+		throw std::runtime_error("Cannot run \"" + command[0] + "\", see \"" 
+			+ err + "\" for details.");
+	result.status = WEXITSTATUS(result.status);
+	return result;
+}
+
+/// Remove the directory and its content if it exists.
+void removeAll(const std::string& path) {
+	auto remove = [](const char* path, const struct stat*, 
+		int, struct FTW*) -> int { return ::remove(path); };
+	if(nftw(path.c_str(), remove, 16, FTW_DEPTH | FTW_PHYS) < 0 
+		&& errno != ENOENT) throw std::runtime_error(path + ": " + strerror(errno));
+}
+
+/// Read the first line of the file.
+std::string firstLine(const std::string& path) {
+	std::ifstream in(path);
+	std::string line;
+	std::getline(in, line);
+	return line;
+}
+
+/// Sum the numeric field of stages, in the statistics report.
+uint64_t sumStages(const std::string& report, const std::string& field) {
+	size_t end = report.find("\"merges\"");
+	uint64_t sum = 0;
+	std::string pattern = "\"" + field + "\": ";
+	for(size_t pos = report.find(pattern); pos < end; 
+		pos = report.find(pattern, pos + 1)) 
+		sum += strtoull(report.c_str() + pos + pattern.size(), nullptr, 10);
+	return sum;
+}
+
+/// Retrieve the numeric field of the JSON object line.
+double field(const std::string& line, const std::string& name) {
+	std::string pattern = "\"" + name + "\": ";
+	size_t pos = line.find(pattern);
+	if(pos == std::string::npos) return -1.0;
+	return strtod(line.c_str() + pos + pattern.size(), nullptr);
+}
+
+/// Retrieve the string field of the JSON object line.
+std::string stringField(const std::string& line, const std::string& name) {
+	std::string pattern = "\"" + name + "\": \"";
+	size_t pos = line.find(pattern);
+	if(pos == std::string::npos) return "";
+	pos += pattern.size();
+	return line.substr(pos, line.find('"', pos) - pos);
+}
+
+/// Split the arguments separated by whitespaces.
+std::vector<std::string> words(const std::string& args) {
+	std::vector<std::string> result;
+	std::stringstream in(args);
+	std::string item;
+	while(in >> item) result.push_back(item);
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string gen, scratch, baseline, memories, syncs, threads;
+	std::vector<std::string> binaries, corpora;
+	double tolerance; size_t repeat;
+	po::options_description usage("Options");
+	usage.add_options()
+		("help,h", "Print this help message.")
+		("gen,g", po::value<std::string>(&gen)->default_value("wdedup-gen"),
+			"The path to the corpus generator.")
+		("binary,b", po::value<std::vector<std::string>>(&binaries),
+			"The wdedup binary to run, as NAME=PATH or PATH, which could "
+			"be specified multiple times. Defaults to \"wdedup\".")
+		("corpus,c", po::value<std::vector<std::string>>(&corpora),
+			"The arguments passed to the generator for a corpus, which "
+			"could be specified multiple times. Defaults to \"--size 256m\".")
+		("memory-size,m", po::value<std::string>(&memories)
+			->default_value("64m,256m"), "The comma separated sizes of "
+			"working memory.")
+		("sync-distance,d", po::value<std::string>(&syncs)
+			->default_value("2g"), "The comma separated synchronization "
+			"distances.")
+		("threads,t", po::value<std::string>(&threads)->default_value("1"),
+			"The comma separated numbers of threads.")
+		("repeat,r", po::value<size_t>(&repeat)->default_value(1),
+			"The number of runs of each configuration, whose fastest "
+			"run is taken.")
+		("scratch,s", po::value<std::string>(&scratch)
+			->default_value("wdedup-e2e.scratch"), "The directory to "
+			"place the corpora and working directories.")
+		("baseline", po::value<std::string>(&baseline)->default_value(""),
+			"The file of previously printed measurements to compare with.")
+		("tolerance", po::value<double>(&tolerance)->default_value(0.1),
+			"The ratio that the measurements could exceed the baseline.");
+
+	bool regressed = false;
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, usage), vm);
+		po::notify(vm);
+		if(vm.count("help")) {
+			std::cerr << "Usage: " << argv[0] << " [--flags]" << std::endl
+				<< "Benchmarks wdedup end to end on generated corpora." 
+				<< std::endl << usage << std::endl;
+			return 0;
+		}
+		if(binaries.empty()) binaries.push_back("wdedup");
+		if(corpora.empty()) corpora.push_back("--size 256m");
+		if(repeat == 0) repeat = 1;
+
+		// Load the baseline measurements by their keys.
+		std::map<std::string, std::string> baselines;
+		if(baseline != "") {
+			std::ifstream in(baseline);
+			if(!in) throw std::runtime_error(baseline + ": cannot open");
+			std::string line;
+			while(std::getline(in, line)) 
+				if(line != "") baselines[stringField(line, "key")] = line;
+		}
+
+		if(mkdir(scratch.c_str(), 0755) < 0 && errno != EEXIST)
+			throw std::runtime_error(scratch + ": " + strerror(errno));
+		std::string log = scratch + "/stderr", output = scratch + "/stdout";
+		for(size_t c = 0; c < corpora.size(); ++ c) {
+			// Generate the corpus and its expected answer.
+			std::string corpus = scratch + "/corpus" + std::to_string(c);
+			std::vector<std::string> command = { gen, "-o", corpus + ".txt", 
+				"-a", corpus + ".ans" };
+			for(const std::string& arg : words(corpora[c])) command.push_back(arg);
+			if(run(command, "/dev/null", log).status != 0) 
+				throw std::runtime_error("Cannot generate corpus \"" 
+					+ corpora[c] + "\", see \"" + log + "\" for details.");
+			std::string answer = firstLine(corpus + ".ans");
+
+			for(const std::string& binary : binaries) 
+			for(const std::string& memory : split(memories))
+			for(const std::string& sync : split(syncs))
+			for(const std::string& thread : split(threads)) {
+				size_t eq = binary.find('=');
+				std::string name = eq == std::string::npos? binary : binary.substr(0, eq);
+				std::string path = eq == std::string::npos? binary : binary.substr(eq + 1);
+				std::string key = name + " " + corpora[c] + " -m " + memory 
+					+ " -d " + sync + " -t " + thread;
+
+				// Take the fastest run among the repeated runs.
+				Run best = Run(); bool correct = true; uint64_t read = 0, written = 0;
+				for(size_t r = 0; r < repeat; ++ r) {
+					std::string workdir = scratch + "/workdir";
+					removeAll(workdir);
+					Run current = run({ path, "--stats", "-m", memory, "-d", sync, 
+						"-t", thread, corpus + ".txt", workdir }, output, log);
+					std::ifstream in(log);
+					std::string report((std::istreambuf_iterator<char>(in)), 
+						std::istreambuf_iterator<char>());
+					correct = correct && current.status == 0 
+						&& firstLine(output) == answer;
+					if(r == 0 || current.wallSeconds < best.wallSeconds) {
+						best = current;
+						read = sumStages(report, "bytesRead");
+						written = sumStages(report, "bytesWritten");
+					}
+				}
+
+				std::stringstream line;
+				line.precision(9);
+				line << "{\"key\": \"" << key << "\", \"binary\": \"" << name 
+					<< "\", \"corpus\": \"" << corpora[c] << "\", \"memorySize\": \"" 
+					<< memory << "\", \"syncDistance\": \"" << sync 
+					<< "\", \"threads\": " << thread << ", \"correct\": " 
+					<< (correct? "true" : "false") << ", \"wallSeconds\": " 
+					<< best.wallSeconds << ", \"bytesRead\": " << read 
+					<< ", \"bytesWritten\": " << written << ", \"peakRssBytes\": " 
+					<< best.peakRssBytes;
+
+				// Compare with the baseline of the same key.
+				auto found = baselines.find(key);
+				if(found != baselines.end()) {
+					std::vector<std::string> regressions;
+					if(!correct) regressions.push_back("correct");
+					for(const char* metric : { "wallSeconds", "bytesRead", 
+						"bytesWritten", "peakRssBytes" }) {
+						double base = field(found->second, metric);
+						double value = field(line.str(), metric);
+						if(base >= 0 && value > base * (1.0 + tolerance)) 
+							regressions.push_back(metric);
+					}
+					line << ", \"regressions\": [";
+					for(size_t i = 0; i < regressions.size(); ++ i)
+						line << (i? ", \"" : "\"") << regressions[i] << "\"";
+					line << "]";
+					if(!regressions.empty()) regressed = true;
+				} else if(!correct) regressed = true;
+				line << "}";
+				std::cout << line.str() << std::endl;
+			}
+			remove((corpus + ".txt").c_str());
+		}
+	} catch(std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return regressed? 1 : 0;
+}
@@ -0,0 +1,345 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wdedupgen.cpp
+ * @author Haoran Luo
+ * @brief wdedup Synthetic Corpus Generator
+ *
+ * This file generates synthetic original files for performance 
+ * testing, which are reproducible from the seed and the parameters,
+ * so that the files need not to be stored.
+ *
+ * The file is a body followed by an epilogue. The body is divided 
+ * into blocks of fixed target size, and the words of each block are
+ * derived from the seed and the block index only, so that the blocks 
+ * could be generated in parallel. The words of the body are drawn 
+ * from the vocabulary in Zipfian distribution, by rejection-inversion
+ * sampling, and the epilogue contains every word of the vocabulary 
+ * twice, so that no word of the vocabulary is non-repeating.
+ *
+ * The non-repeating words are planted into the body at positions 
+ * derived from the seed, and they contain digits while words of the
+ * vocabulary do not, so that they are distinct. Since the positions 
+ * are known without generating the file, the expected answer (every
+ * non-repeating word in order of their occurence, just like the 
+ * output of wdedup --list-all) could be written out as well.
+ */
+#include "impl/wpool.hpp"
+#include "wbench.hpp"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using wdedup::SplitMix;
+using wdedup::parseSize;
+
+/// Mix the seed with the stream identifiers.
+uint64_t mix(uint64_t seed, uint64_t a, uint64_t b = 0) noexcept {
+	SplitMix random(seed ^ (a * 0xd1b54a32d192ed03ull) 
+		^ (b * 0xabc98388fb8fac03ull));
+	return random();
+}
+
+/**
+ * @brief Samples the ranks in [1, n] in Zipfian distribution.
+ *
+ * The sampler performs rejection-inversion sampling (Hormann and
+ * Derflinger, 1996), which takes constant memory and expected time 
+ * for any exponent, however large the vocabulary is.
+ */
+class ZipfSampler {
+	double n, exponent, hIntegralX1, hIntegralN, s;
+
+	static double helper1(double x) noexcept {
+		return std::fabs(x) > 1e-8? std::log1p(x) / x 
+			: 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+	}
+	static double helper2(double x) noexcept {
+		return std::fabs(x) > 1e-8? std::expm1(x) / x 
+			: 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+	}
+	double h(double x) const noexcept { 
+		return std::exp(-exponent * std::log(x)); 
+	}
+	double hIntegral(double x) const noexcept {
+		double logX = std::log(x);
+		return helper2((1.0 - exponent) * logX) * logX;
+	}
+	double hIntegralInverse(double x) const noexcept {
+		double t = x * (1.0 - exponent);
+		if(t < -1.0) t = -1.0;
+		return std::exp(helper1(t) * x);
+	}
+public:
+	ZipfSampler(uint64_t n, double exponent) noexcept: 
+		n((double)n), exponent(exponent) {
+		hIntegralX1 = hIntegral(1.5) - 1.0;
+		hIntegralN = hIntegral(this->n + 0.5);
+		s = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+	}
+
+	uint64_t operator()(SplitMix& random) const noexcept {
+		while(true) {
+			double u = hIntegralN + random.uniform() * (hIntegralX1 - hIntegralN);
+			double x = hIntegralInverse(u);
+			double k = std::floor(x + 0.5);
+			if(k < 1.0) k = 1.0; else if(k > n) k = n;
+			if(k - x <= s || u >= hIntegral(k + 0.5) - h(k)) 
+				return (uint64_t)k;
+		}
+	}
+};
+
+/// The parameters of the corpus.
+struct Corpus {
+	uint64_t size, vocabulary, unique, seed;
+	double zipf;
+	size_t minLength, maxLength;
+	std::string placement;
+
+	/// The target size of a block of the body.
+	static constexpr size_t blockSize = 1 << 20;
+
+	/// The number of blocks of the body.
+	uint64_t blocks;
+
+	/// The planted non-repeating words, as (block, position, index).
+	std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> plants;
+
+	/// Derive the word of the vocabulary, with only letters.
+	std::string word(uint64_t index) const {
+		SplitMix random(mix(seed, 1, index));
+		size_t length = minLength + random() % (maxLength - minLength + 1);
+		std::string result(length, 'a');
+		for(size_t i = 0; i < length; ++ i) result[i] = 'a' + random() % 26;
+
+		// The index is encoded at the tail so that words are distinct,
+		// with a leading 'z' so that the encoding is prefix-free.
+		size_t i = length;
+		for(uint64_t v = index; v > 0; v /= 25) result[-- i] = 'a' + v % 25;
+		result[-- i] = 'z';
+		return result;
+	}
+
+	/// Derive the non-repeating word, containing digits.
+	std::string uniqueWord(uint64_t index) const {
+		SplitMix random(mix(seed, 2, index));
+		size_t length = minLength + random() % (maxLength - minLength + 1);
+		std::string result(length, 'a');
+		for(size_t i = 0; i < length; ++ i) result[i] = 'a' + random() % 26;
+		return result + std::to_string(index);
+	}
+
+	/// Plan the body and the positions of the non-repeating words.
+	void plan() {
+		// The index encoding takes a 'z' and base-25 digits.
+		size_t digits = 2;
+		for(uint64_t v = vocabulary; v >= 25; v /= 25) ++ digits;
+		if(minLength < digits) minLength = digits;
+		if(maxLength < minLength) maxLength = minLength;
+
+		// The epilogue takes every word twice, and the body takes the
+		// remaining size.
+		uint64_t epilogue = 0;
+		for(uint64_t i = 0; i < vocabulary; ++ i) epilogue += 2 * (word(i).size() + 1);
+		if(size <= epilogue) throw std::logic_error("The size should be greater "
+			"than " + std::to_string(epilogue) + " bytes, taken by the "
+			"vocabulary twice.");
+		blocks = (size - epilogue + blockSize - 1) / blockSize;
+
+		// The non-repeating words are placed in the first or last 1%
+		// of the blocks, or uniformly in the body.
+		uint64_t first = 0, count = blocks;
+		if(placement == "head" || placement == "tail") {
+			count = std::max<uint64_t>(1, blocks / 100);
+			if(placement == "tail") first = blocks - count;
+		} else if(placement != "uniform") 
+			throw std::logic_error("Unknown placement: \"" + placement + "\".");
+		uint64_t words = blockSize / ((minLength + maxLength) / 2 + 1);
+		for(uint64_t k = 0; k < unique; ++ k) {
+			SplitMix random(mix(seed, 3, k));
+			uint64_t block = first + random() % count;
+			plants.push_back(std::make_tuple(block, random() % words, k));
+		}
+		std::sort(plants.begin(), plants.end());
+	}
+
+	/// Generate the specified block of the body.
+	std::string block(uint64_t index, const ZipfSampler& zipf) const {
+		SplitMix random(mix(seed, 4, index));
+		std::string result; result.reserve(blockSize + maxLength * 2);
+		auto plant = std::lower_bound(plants.begin(), plants.end(),
+			std::make_tuple(index, (uint64_t)0, (uint64_t)0));
+		uint64_t position = 0;
+		auto append = [&](const std::string& w) {
+			result += w;
+			result += (++ position % 16 == 0)? '\n' : ' ';
+		};
+		while(result.size() < blockSize) {
+			while(plant != plants.end() && std::get<0>(*plant) == index 
+				&& std::get<1>(*plant) <= position) 
+				append(uniqueWord(std::get<2>(*(plant ++))));
+			append(word(zipf(random) - 1));
+		}
+
+		// The remaining plants are placed at the end of the block.
+		while(plant != plants.end() && std::get<0>(*plant) == index)
+			append(uniqueWord(std::get<2>(*(plant ++))));
+		return result;
+	}
+
+	/// Generate the epilogue, every word twice in shuffled order.
+	std::string epilogue() const {
+		std::vector<uint64_t> order;
+		for(uint64_t i = 0; i < vocabulary; ++ i) { 
+			order.push_back(i); order.push_back(i); 
+		}
+		SplitMix random(mix(seed, 5));
+		for(size_t i = order.size(); i > 1; -- i) 
+			std::swap(order[i - 1], order[random() % i]);
+		std::string result;
+		for(size_t i = 0; i < order.size(); ++ i) {
+			result += word(order[i]);
+			result += ((i + 1) % 16 == 0)? '\n' : ' ';
+		}
+		return result;
+	}
+};
+
+/// Write out the whole buffer to the file descriptor.
+void writeAll(int fd, const std::string& data, const std::string& path) {
+	size_t written = 0;
+	while(written < data.size()) {
+		ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+		if(n < 0 && errno == EINTR) continue;
+		if(n < 0) throw std::runtime_error(path + ": " + strerror(errno));
+		written += n;
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	Corpus corpus;
+	std::string size, output, answer;
+	size_t threads;
+	po::options_description usage("Options");
+	usage.add_options()
+		("help,h", "Print this help message.")
+		("output,o", po::value<std::string>(&output)->default_value("-"),
+			"The file to write, or \"-\" for standard output.")
+		("answer,a", po::value<std::string>(&answer)->default_value(""),
+			"The file to write the expected answer, which is every "
+			"non-repeating word in order of occurence.")
+		("size,s", po::value<std::string>(&size)->default_value("1g"),
+			"The size of the generated file.")
+		("vocabulary,v", po::value<uint64_t>(&corpus.vocabulary)
+			->default_value(100000), "The number of repeating words.")
+		("zipf,z", po::value<double>(&corpus.zipf)->default_value(1.0),
+			"The exponent of Zipfian distribution of the words.")
+		("min-length", po::value<size_t>(&corpus.minLength)->default_value(3),
+			"The minimum length of words.")
+		("max-length", po::value<size_t>(&corpus.maxLength)->default_value(12),
+			"The maximum length of words, uniformly distributed from "
+			"the minimum length.")
+		("unique,u", po::value<uint64_t>(&corpus.unique)->default_value(100),
+			"The number of non-repeating words.")
+		("placement,p", po::value<std::string>(&corpus.placement)
+			->default_value("uniform"), "The placement of non-repeating "
+			"words, which is \"head\", \"tail\" or \"uniform\".")
+		("seed", po::value<uint64_t>(&corpus.seed)->default_value(1),
+			"The seed that the file is reproduced from.")
+		("threads,t", po::value<size_t>(&threads)->default_value(0),
+			"The number of threads, the number of processors if 0.");
+
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, usage), vm);
+		po::notify(vm);
+		if(vm.count("help")) {
+			std::cerr << "Usage: " << argv[0] << " [--flags]" << std::endl
+				<< "Generates a synthetic original file for wdedup." 
+				<< std::endl << usage << std::endl;
+			return 0;
+		}
+		corpus.size = parseSize(size);
+		if(corpus.vocabulary == 0) 
+			throw std::logic_error("The vocabulary should not be empty.");
+		if(corpus.zipf <= 0.0) 
+			throw std::logic_error("The exponent should be positive.");
+		if(threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+		corpus.plan();
+
+		// Write out the expected answer first.
+		if(answer != "") {
+			std::ofstream out(answer);
+			for(size_t i = 0; i < corpus.plants.size(); ++ i)
+				out << corpus.uniqueWord(std::get<2>(corpus.plants[i])) << '\n';
+			if(!out.flush()) throw std::runtime_error(answer + ": cannot write");
+		}
+
+		// Generate the blocks in rounds, which are written in order.
+		int fd = output == "-"? STDOUT_FILENO : 
+			open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0) throw std::runtime_error(output + ": " + strerror(errno));
+		ZipfSampler zipf(corpus.vocabulary, corpus.zipf);
+		wdedup::ThreadPool pool(threads);
+		std::vector<std::string> round(threads * 2);
+		for(uint64_t first = 0; first < corpus.blocks; first += round.size()) {
+			size_t count = std::min<uint64_t>(round.size(), corpus.blocks - first);
+			wdedup::TaskGroup group(pool);
+			for(size_t i = 0; i < count; ++ i) group.run([&, i]() {
+				round[i] = corpus.block(first + i, zipf);
+			});
+			group.wait();
+			for(size_t i = 0; i < count; ++ i) writeAll(fd, round[i], output);
+		}
+		writeAll(fd, corpus.epilogue(), output);
+		if(fd != STDOUT_FILENO && close(fd) < 0)
+			throw std::runtime_error(output + ": " + strerror(errno));
+	} catch(std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	} catch(wdedup::Error& err) {
+		std::cerr << "Error: " << err.path << ": " 
+			<< strerror(err.eno) << std::endl;
+		return 1;
+	}
+	return 0;
+}
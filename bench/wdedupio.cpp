@@ -0,0 +1,185 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wdedupio.cpp
+ * @author Haoran Luo
+ * @brief wdedup I/O Layer Microbenchmark
+ *
+ * This file benchmarks the backends of wdedup::SequentialFile and
+ * wdedup::AppendFile across buffer sizes and record sizes, where the
+ * buffer sizes are configured by wdedup::FileMode::buffers like the
+ * "--buffer-size" flag of wdedup. The backends are:
+ * - append-buffer: wdedup::AppendFileBuffer writing the records, 
+ *   like the profiles are written.
+ * - append-log: wdedup::AppendFileLog writing the records and 
+ *   synchronizing every 1MB, like the log is written. It buffers 
+ *   all content between synchronizations, so it is measured once
+ *   per record size regardless of the buffer size.
+ * - sequential-read: wdedup::SequentialFileBase reading the records
+ *   by copying, like the profiles are read.
+ * - sequential-bufferptr: wdedup::SequentialFileBase scanning the
+ *   records inside its buffer, like the original file is read.
+ *
+ * The file is read right after it is written, so the reads are served
+ * by the page cache, and the overhead of the I/O layer (system calls
+ * and copying) is measured rather than the device. The throughput and
+ * the number of system calls are measured and printed as a line of 
+ * JSON object per measurement.
+ *
+ * Usage: wdedup-iobench [SIZE [BUFSIZE...]], where SIZE defaults to
+ * 64m, and BUFSIZE defaults to 4k 16k 64k 256k 1m. The records are of
+ * 16, 256, 4k and 64k bytes. The file "wdedup-iobench.temp" is created
+ * under current directory and removed afterwards.
+ */
+#include "impl/wiobase.hpp"
+#include "impl/wstats.hpp"
+#include "wbench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wdedup::parseSize;
+
+/// The file that the benchmark writes and reads.
+const char* filename = "wdedup-iobench.temp";
+
+/// The role of the file, whose buffer size is configured.
+const char* role = "bench";
+
+/// The distance between synchronizations of the log.
+const size_t syncDistance = 1 << 20;
+
+/// Retrieve the seconds elapsed since the specified time.
+double since(std::chrono::steady_clock::time_point start) noexcept {
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+/// Print out the measurement of a backend.
+void report(const char* backend, size_t bufsize, size_t record, 
+	size_t size, double seconds, uint64_t calls) {
+	std::cout << "{\"backend\": \"" << backend << "\""
+		<< ", \"bufferSize\": " << bufsize
+		<< ", \"recordSize\": " << record
+		<< ", \"bytes\": " << size
+		<< ", \"seconds\": " << seconds
+		<< ", \"bytesPerSecond\": " << size / seconds
+		<< ", \"syscalls\": " << calls
+		<< ", \"bytesPerSyscall\": " << (calls > 0? size / calls : 0)
+		<< "}" << std::endl;
+}
+
+/// Benchmark writing the file of specified size by records.
+void benchWrite(bool log, size_t bufsize, size_t record, size_t size) {
+	remove(filename);
+	wdedup::FileMode mode;
+	mode.log = log;
+	mode.bufsize = bufsize;
+	std::vector<char> data(record, 'w');
+
+	wdedup::StatsCounters& counters = wdedup::statsCounters();
+	uint64_t calls = counters.writeCalls + counters.syncCalls;
+	auto start = std::chrono::steady_clock::now();
+	{
+		wdedup::AppendFile file(filename, role, mode);
+		size_t unsynced = 0;
+		for(size_t written = 0; written < size; written += record) {
+			file.write(data.data(), record);
+			if(log && (unsynced += record) >= syncDistance) {
+				file.sync(); unsynced = 0;
+			}
+		}
+		file.sync();
+	}
+	double seconds = since(start);
+	calls = counters.writeCalls + counters.syncCalls - calls;
+	report(log? "append-log" : "append-buffer", 
+		log? 0 : bufsize, record, size, seconds, calls);
+}
+
+/// Benchmark reading the file written previously by records.
+void benchRead(bool bufferptr, size_t bufsize, size_t record, size_t size) {
+	wdedup::FileMode mode;
+	mode.bufsize = bufsize;
+	std::vector<char> data(record);
+
+	wdedup::StatsCounters& counters = wdedup::statsCounters();
+	uint64_t calls = counters.readCalls;
+	auto start = std::chrono::steady_clock::now();
+	{
+		wdedup::SequentialFile file(filename, role, mode);
+		size_t sum = 0;
+		if(bufferptr) while(!file.eof()) {
+			char* ptr; size_t available;
+			file.bufferptr(ptr, available);
+			available = std::min(available, record);
+			for(size_t i = 0; i < available; ++ i) sum += ptr[i];
+			file.bufferskip(available);
+		} else for(size_t read = 0; read < size; read += record) {
+			file.read(data.data(), record);
+			sum += data[0];
+		}
+		if(sum == 0) std::cerr << "Nothing has been read." << std::endl;
+	}
+	double seconds = since(start);
+	calls = counters.readCalls - calls;
+	report(bufferptr? "sequential-bufferptr" : "sequential-read", 
+		bufsize, record, size, seconds, calls);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	size_t size = argc > 1? parseSize(argv[1]) : 64 << 20;
+	std::vector<size_t> bufsizes;
+	for(int i = 2; i < argc; ++ i) bufsizes.push_back(parseSize(argv[i]));
+	if(bufsizes.empty()) bufsizes = { 4 << 10, 16 << 10, 
+		64 << 10, 256 << 10, 1 << 20 };
+
+	try {
+		for(size_t record : { 16, 256, 4 << 10, 64 << 10 }) {
+			// The size is rounded down to the multiple of records.
+			size_t total = std::max(size / record, (size_t)1) * record;
+			benchWrite(true, 0, record, total);
+			for(size_t bufsize : bufsizes) {
+				benchWrite(false, bufsize, record, total);
+				benchRead(false, bufsize, record, total);
+				benchRead(true, bufsize, record, total);
+			}
+		}
+	} catch(wdedup::Error& err) {
+		std::cerr << "Error: " << err.path << ": " 
+			<< strerror(err.eno) << std::endl;
+		remove(filename);
+		return 1;
+	}
+	remove(filename);
+	return 0;
+}
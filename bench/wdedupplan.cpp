@@ -0,0 +1,364 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file bench/wdedupplan.cpp
+ * @author Haoran Luo
+ * @brief wdedup Merge Planner Simulator
+ *
+ * This file feeds the sizes of profile segments to the merge planners
+ * without running wmerge, so that the planners could be compared at
+ * large number of segments. The sizes are either synthetic, or taken
+ * from the recovery log of a working directory (whose wprof stage has
+ * been completed), or from a file of sizes, one size per line.
+ *
+ * For each planner, the time of planning (constructing the planner 
+ * and popping all plans), the growth of peak resident set size while
+ * planning, the bytes merged (the sum of sizes of both inputs of every
+ * merge, assuming merged size is the sum of input sizes, which is the 
+ * upper bound when words repeat across segments), and the depth of
+ * the merge tree are measured. Each planner runs in a child process,
+ * so that their memory are measured separately, and the measurement
+ * is printed as a line of JSON object.
+ *
+ * The wdedup::MergePlannerDP takes quadratic memory and cubic time,
+ * so it is skipped when there are more segments than "--dp-limit".
+ * New planners are added to the planners table below.
+ */
+#include "wdedup.hpp"
+#include "wconfig.hpp"
+#include "impl/wmpdp.hpp"
+#include "impl/wmpsimple.hpp"
+#include "wbench.hpp"
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+using wdedup::SplitMix;
+using wdedup::split;
+
+/// The configuration that only the planners would access, which is
+/// logCorrupt() when there's no segment.
+struct PlannerConfig : public wdedup::Config {
+	[[noreturn]] static void unsupported() noexcept {
+		std::cerr << "Error: The planner accesses unsupported " 
+			"configuration." << std::endl;
+		std::abort();
+	}
+	virtual bool hasRecoveryDone() throw (wdedup::Error) override { return true; }
+	virtual wdedup::SequentialFile& ilog() noexcept override { unsupported(); }
+	virtual wdedup::AppendFile& olog() noexcept override { unsupported(); }
+	virtual void recoveryDone() throw (wdedup::Error) override {}
+	virtual void logCorrupt() throw (wdedup::Error) override {
+		throw wdedup::Error(EIO, "", "planner");
+	}
+	virtual std::unique_ptr<wdedup::ProfileOutput> openOutput(
+		std::string) throw (wdedup::Error) override { unsupported(); }
+	virtual std::unique_ptr<wdedup::ProfileInput> openInput(
+		std::string) throw (wdedup::Error) override { unsupported(); }
+	virtual std::unique_ptr<wdedup::ProfileInput> openInput(std::string, 
+		const wdedup::ProfileBlock&) throw (wdedup::Error) override { unsupported(); }
+	virtual std::vector<wdedup::ProfileBlock> openIndex(
+		std::string) throw (wdedup::Error) override { unsupported(); }
+	virtual std::unique_ptr<wdedup::ProfileLookup> openLookup(
+		std::string) throw (wdedup::Error) override { unsupported(); }
+	virtual std::unique_ptr<wdedup::ProfileInput> openSingularInput(
+		std::string) throw (wdedup::Error) override { unsupported(); }
+	virtual void remove(std::string) throw (wdedup::Error) override {}
+	virtual wdedup::MemoryBudget& budget() noexcept override { unsupported(); }
+	virtual wdedup::SegmentCache* cache() noexcept override { return nullptr; }
+	virtual wdedup::ThreadPool& pool() noexcept override { unsupported(); }
+	virtual bool overlapPour() noexcept override { return false; }
+	virtual wdedup::StatsReport* stats() noexcept override { return nullptr; }
+	virtual wdedup::ProgressReport& progress() noexcept override { unsupported(); }
+};
+
+/// The planner that could be simulated.
+struct Planner {
+	/// The name of the planner.
+	const char* name;
+
+	/// Construct the planner on the segments.
+	std::function<std::unique_ptr<wdedup::MergePlanner>(wdedup::Config&, 
+		const std::vector<wdedup::ProfileSegment>&)> create;
+};
+
+/// The planners that could be simulated.
+const std::vector<Planner>& planners() {
+	static const std::vector<Planner> table = {
+		{ "dp", [](wdedup::Config& config, 
+			const std::vector<wdedup::ProfileSegment>& segments) {
+			return std::unique_ptr<wdedup::MergePlanner>(
+				new wdedup::MergePlannerDP(config, segments)); } },
+		{ "simple", [](wdedup::Config& config, 
+			const std::vector<wdedup::ProfileSegment>& segments) {
+			return std::unique_ptr<wdedup::MergePlanner>(
+				new wdedup::MergePlannerSimple(config, segments)); } },
+	};
+	return table;
+}
+
+/// Generate the sizes of synthetic segments of the distribution.
+std::vector<size_t> synthesize(const std::string& distribution, 
+	size_t segments, size_t mean, double sigma, uint64_t seed) {
+	std::vector<size_t> sizes;
+	SplitMix random(seed);
+	for(size_t i = 0; i < segments; ++ i) {
+		double size = mean;
+		if(distribution == "equal") size = mean;
+		else if(distribution == "tail") {
+			// Segments are equal but the last one, which is cut by 
+			// the end of the original file.
+			if(i + 1 == segments) size = mean * (1.0 - random.uniform());
+		} else if(distribution == "lognormal") {
+			// The Box-Muller transform, scaled to keep the mean.
+			double normal = std::sqrt(-2.0 * std::log(1.0 - random.uniform()))
+				* std::cos(2.0 * M_PI * random.uniform());
+			size = mean * std::exp(sigma * normal - sigma * sigma / 2);
+		} else if(distribution == "pareto") {
+			// The shape is 1 + 1 / sigma, scaled to keep the mean.
+			double shape = 1.0 + 1.0 / sigma;
+			size = mean * (shape - 1) / shape 
+				* std::pow(1.0 - random.uniform(), -1.0 / shape);
+		} else throw std::logic_error("Unknown distribution: \"" 
+			+ distribution + "\".");
+		sizes.push_back(std::max<size_t>((size_t)size, 1));
+	}
+	return sizes;
+}
+
+/// Read the sizes of segments from the recovery log, which must have 
+/// recorded the end of wprof stage. The metadata of version and the
+/// counting flag (see main.cpp) are skipped. See WProfLog in wprof.cpp.
+std::vector<size_t> recorded(const std::string& path) throw (wdedup::Error) {
+	std::vector<size_t> sizes;
+	wdedup::FileMode mode;
+	wdedup::SequentialFile log(path, "log", mode);
+	std::string version; char counting; log >> version >> counting;
+	while(!log.eof()) {
+		char type; log >> type;
+		if(type == 'e') return sizes;
+		if(type != 's') break;
+		wdedup::fileoff_t start, end, size;
+		uint64_t fields, value;
+		log >> start >> end >> size >> wdedup::varint(fields);
+		for(uint64_t i = 0; i < fields; ++ i) log >> wdedup::varint(value);
+		sizes.push_back(size);
+	}
+	throw wdedup::Error(EIO, path, "log");
+}
+
+/// Read the sizes of segments from the file, one size per line.
+std::vector<size_t> listed(const std::string& path) {
+	std::ifstream in(path);
+	if(!in) throw std::runtime_error(path + ": cannot open");
+	std::vector<size_t> sizes;
+	size_t size;
+	while(in >> size) sizes.push_back(size);
+	return sizes;
+}
+
+/// Retrieve the peak resident set size of current process.
+uint64_t peakRss() noexcept {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+/// Simulate the planner on the segments and print the measurement.
+void simulate(const Planner& planner, 
+	const std::vector<wdedup::ProfileSegment>& segments) {
+	PlannerConfig config;
+	std::vector<wdedup::MergePlan> plans;
+	uint64_t rss = peakRss();
+	auto start = std::chrono::steady_clock::now();
+	size_t root = segments[0].id;
+	{
+		std::unique_ptr<wdedup::MergePlanner> merger = 
+			planner.create(config, segments);
+		wdedup::MergePlan plan = wdedup::MergePlan();
+		plan.id = root;
+		while(merger->pop(plan)) plans.push_back(plan);
+
+		// The only segment is the root when nothing is merged.
+		if(!plans.empty()) root = plan.id;
+	}
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	rss = peakRss() - rss;
+
+	// Replay the plans, where every segment must be merged once.
+	std::map<size_t, std::pair<size_t, size_t>> nodes; // size, depth.
+	size_t leafSize = 0;
+	for(const wdedup::ProfileSegment& segment : segments) {
+		nodes[segment.id] = std::make_pair(segment.size, 0);
+		leafSize += segment.size;
+	}
+	size_t merged = 0, predicted = 0;
+	for(const wdedup::MergePlan& plan : plans) {
+		auto left = nodes.find(plan.left), right = nodes.find(plan.right);
+		if(left == nodes.end() || right == nodes.end() || plan.left == plan.right
+			|| nodes.count(plan.id)) throw std::logic_error(
+			std::string("Invalid plan of planner \"") + planner.name + "\".");
+		nodes[plan.id] = std::make_pair(left->second.first + right->second.first,
+			std::max(left->second.second, right->second.second) + 1);
+		merged += left->second.first + right->second.first;
+		predicted += plan.cost;
+		nodes.erase(left); nodes.erase(plan.right);
+	}
+	if(nodes.size() != 1 || nodes.begin()->first != root) 
+		throw std::logic_error(std::string("Incomplete plan of planner \"") 
+			+ planner.name + "\".");
+
+	std::cout << "{\"planner\": \"" << planner.name << "\""
+		<< ", \"segments\": " << segments.size()
+		<< ", \"segmentBytes\": " << leafSize
+		<< ", \"merges\": " << plans.size()
+		<< ", \"planSeconds\": " << seconds
+		<< ", \"peakRssGrowthBytes\": " << rss
+		<< ", \"bytesMerged\": " << merged
+		<< ", \"mergeAmplification\": " << (double)merged / leafSize
+		<< ", \"estimatedCost\": " << predicted
+		<< ", \"depth\": " << nodes.begin()->second.second
+		<< "}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string distribution, log, sizes, names;
+	size_t segments, mean, dpLimit; double sigma; uint64_t seed;
+	po::options_description usage("Options");
+	usage.add_options()
+		("help,h", "Print this help message.")
+		("planners,p", po::value<std::string>(&names)
+			->default_value("dp,simple"), "The comma separated planners.")
+		("segments,n", po::value<size_t>(&segments)->default_value(1000),
+			"The number of synthetic segments.")
+		("distribution", po::value<std::string>(&distribution)
+			->default_value("tail"), "The distribution of synthetic sizes, "
+			"which is \"equal\", \"tail\" (equal but the last one), "
+			"\"lognormal\" or \"pareto\".")
+		("mean", po::value<size_t>(&mean)->default_value(64 << 20),
+			"The mean size of synthetic segments.")
+		("sigma", po::value<double>(&sigma)->default_value(1.0),
+			"The dispersion of sizes, which is the sigma of lognormal, or "
+			"the reciprocal of the shape minus one of pareto.")
+		("seed", po::value<uint64_t>(&seed)->default_value(1),
+			"The seed of synthetic sizes.")
+		("log,l", po::value<std::string>(&log)->default_value(""),
+			"Take the sizes from the recovery log of a working directory, "
+			"like \"WORKDIR/log\", instead of synthetic sizes.")
+		("sizes,s", po::value<std::string>(&sizes)->default_value(""),
+			"Take the sizes from the file, one size per line, instead of "
+			"synthetic sizes.")
+		("dp-limit", po::value<size_t>(&dpLimit)->default_value(2048),
+			"The maximum number of segments to simulate the dp planner.");
+
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, usage), vm);
+		po::notify(vm);
+		if(vm.count("help")) {
+			std::cerr << "Usage: " << argv[0] << " [--flags]" << std::endl
+				<< "Simulates the merge planners on segment sizes." 
+				<< std::endl << usage << std::endl;
+			return 0;
+		}
+
+		// Collect the sizes of segments.
+		std::vector<size_t> lengths = log != ""? recorded(log) : sizes != ""? 
+			listed(sizes) : synthesize(distribution, segments, mean, sigma, seed);
+		if(lengths.empty()) throw std::logic_error("There's no segment.");
+		std::vector<wdedup::ProfileSegment> profiles;
+		size_t offset = 0;
+		for(size_t i = 0; i < lengths.size(); ++ i) {
+			wdedup::ProfileSegment segment;
+			segment.id = i;
+			segment.start = offset;
+			segment.end = offset + lengths[i] - 1;
+			segment.size = lengths[i];
+			profiles.push_back(segment);
+			offset += lengths[i];
+		}
+
+		for(const std::string& name : split(names)) {
+			auto planner = std::find_if(planners().begin(), planners().end(),
+				[&](const Planner& p) { return name == p.name; });
+			if(planner == planners().end()) 
+				throw std::logic_error("Unknown planner: \"" + name + "\".");
+			if(name == "dp" && profiles.size() > dpLimit) {
+				std::cout << "{\"planner\": \"" << name << "\", \"segments\": " 
+					<< profiles.size() << ", \"skipped\": true}" << std::endl;
+				continue;
+			}
+
+			// Simulate in a child process, so that the peak resident set
+			// size of the planner is measured separately.
+			std::cout.flush();
+			pid_t pid = fork();
+			if(pid < 0) throw std::runtime_error(
+				std::string("fork: ") + strerror(errno));
+			if(pid == 0) {
+				int status = 0;
+				try { simulate(*planner, profiles); }
+				catch(std::exception& e) { 
+					std::cerr << "Error: " << e.what() << std::endl; status = 1; }
+				catch(wdedup::Error& err) { 
+					std::cerr << "Error: " << strerror(err.eno) << std::endl; status = 1; }
+				std::cout.flush();
+				_exit(status);
+			}
+			int status;
+			while(waitpid(pid, &status, 0) < 0 && errno == EINTR);
+			if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) 
+				throw std::runtime_error("Simulation of \"" + name + "\" failed.");
+		}
+	} catch(std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	} catch(wdedup::Error& err) {
+		std::cerr << "Error: " << err.path << ": " 
+			<< strerror(err.eno) << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,192 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wbudget.hpp
+ * @author Haoran Luo
+ * @brief wdedup Memory Budget Manager
+ *
+ * This file defines the memory budget manager, which carves the 
+ * working memory into leases for the stages running concurrently.
+ * A lease is a contiguous region of the working memory, which is 
+ * returned to the budget once the lease is destroyed. A request that
+ * could not be placed waits until enough memory has been returned,
+ * so the working memory in use never exceeds the budget.
+ *
+ * The budget could also be resized within the working memory by a 
+ * governor, which is consulted by stages at their boundaries (like
+ * the segment boundaries of wprof), so that the working memory could
+ * be shrunk under memory pressure and grown back afterwards.
+ */
+#pragma once
+#include "wtypes.hpp"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace wdedup {
+
+class MemoryBudget;
+
+/// @brief Advises the size of the memory budget.
+struct MemoryGovernor {
+	/// Virtual destructor for pure virtual class.
+	virtual ~MemoryGovernor() noexcept {}
+
+	/// Advise the size of the budget, given the current size and the
+	/// size of the working memory. It will be applied when it differs.
+	virtual size_t advise(size_t current, size_t capacity) noexcept = 0;
+};
+
+/// @brief A region leased from the memory budget.
+class MemoryLease {
+	/// The budget that the region is leased from.
+	wdedup::MemoryBudget* budget;
+
+	/// The leased region.
+	char* region; size_t length;
+
+	/// Only the budget could create leases.
+	friend class wdedup::MemoryBudget;
+public:
+	/// Construct an empty lease.
+	MemoryLease() noexcept: budget(nullptr), region(nullptr), length(0) {}
+
+	/// Move constructor of the lease.
+	MemoryLease(MemoryLease&& l) noexcept: budget(l.budget), 
+		region(l.region), length(l.length) {
+		l.budget = nullptr; l.region = nullptr; l.length = 0;
+	}
+
+	/// Move assignment of the lease, the previous lease is released.
+	MemoryLease& operator=(MemoryLease&& l) noexcept;
+
+	/// Copy constructor is deleted for the lease.
+	MemoryLease(const MemoryLease&) = delete;
+
+	/// Release the region back to the budget.
+	~MemoryLease() noexcept;
+
+	/// Retrieve the leased region.
+	void* data() const noexcept { return region; }
+
+	/// Retrieve the size of the leased region.
+	size_t size() const noexcept { return length; }
+};
+
+/// @brief The memory budget carving the working memory into leases.
+class MemoryBudget {
+	/// The working memory and its size.
+	char* arena; size_t total;
+
+	/// The current size of the budget, no region beyond it will be
+	/// leased, and free regions beyond it are returned to the system.
+	size_t limit;
+
+	/// The governor resizing the budget, nullptr if disabled.
+	wdedup::MemoryGovernor* governor;
+
+	/// The free regions of the working memory, keyed by their offset
+	/// and mapped to their size. Adjacent regions are coalesced.
+	std::map<size_t, size_t> regions;
+
+	/// The size of memory that is leased currently, and its peak.
+	size_t leased, peak;
+
+	/// The requests wait on the condition for returned memory.
+	std::mutex mutex;
+	std::condition_variable returned;
+
+	/// Place a region of the specified size, nullptr will be returned 
+	/// if there's no free region large enough. Mutex must be held.
+	char* place(size_t size) noexcept;
+
+	/// Return the region to the free regions.
+	void release(char* region, size_t size) noexcept;
+
+	friend class wdedup::MemoryLease;
+public:
+	/// The size that the leases are rounded up to.
+	static constexpr size_t alignment = 64;
+
+	/// Construct the budget over the specified working memory, whose
+	/// size is rounded down to alignment.
+	MemoryBudget(void* arena, size_t capacity) noexcept;
+
+	/// Retrieve the size of the working memory.
+	size_t capacity() const noexcept { return total; }
+
+	/// Retrieve the current size of the budget.
+	size_t size() noexcept;
+
+	/// Resize the budget within the working memory, and return the 
+	/// free regions beyond the budget to the system. The leases beyond
+	/// the new size are kept until they are returned. The applied size
+	/// is returned, which is rounded down to alignment.
+	size_t resize(size_t size) noexcept;
+
+	/// Set the governor of the budget, nullptr to disable resizing.
+	void govern(wdedup::MemoryGovernor* g) noexcept { governor = g; }
+
+	/// Consult the governor and resize the budget if advised. It 
+	/// should be called at segment boundaries, when only the leases
+	/// of segments being poured out are held.
+	void adapt() noexcept;
+
+	/// Retrieve the peak size of memory that has been leased.
+	size_t peakLeased() noexcept;
+
+	/**
+	 * @brief Lease a region of the specified size.
+	 *
+	 * The request will wait until a region large enough has been 
+	 * returned by other leases. The size is rounded up to alignment.
+	 * @throw std::logic_error when the request exceeds the current
+	 * size of the budget, so that it could never be satisfied.
+	 */
+	wdedup::MemoryLease acquire(size_t size);
+
+	/// Attempt to lease a region of the specified size without 
+	/// waiting, an empty lease will be returned on failure.
+	wdedup::MemoryLease tryAcquire(size_t size) noexcept;
+};
+
+/**
+ * @brief Compute the share of the working memory reserved for I/O.
+ *
+ * The file buffers are allocated along with the files instead of
+ * being leased, so the share for the buffers of the files open at
+ * the same time is reserved off the top of the working memory, and
+ * the budget is carved from the rest. The share takes no more than a
+ * quarter of the working memory, rounded down to alignment.
+ *
+ * Some memory still stays outside both the budget and the share: the
+ * records pending in the log between synchronizations, the block
+ * index and filter offsets of profiles being read, the hashes of the
+ * block being written for its filter, and the content of the chunk
+ * being profiled when the segment cache is enabled (up to the maximum
+ * chunk size plus the last word). They are bounded by the records of
+ * a stage, by the blocks of a profile, or by the chunking parameters.
+ */
+size_t ioShare(size_t workmem, size_t files, size_t buffer) noexcept;
+
+} // namespace wdedup
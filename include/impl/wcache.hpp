@@ -0,0 +1,76 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wcache.hpp
+ * @author Haoran Luo
+ * @brief wdedup Simple Segment Cache
+ *
+ * This file defines the segment cache stored under a directory, where
+ * each cached profile is a simple formatted profile named after its 
+ * key. The profiles are written under temporary names and renamed
+ * after they are closed, so that the directory could be shared by 
+ * multiple tasks running concurrently. The occupancy of each cached
+ * segment is stored beside the profile, and published before it. The
+ * cached profiles are only read sequentially, so they are written
+ * without the index and filter sidecar files.
+ */
+#pragma once
+#include "wconfig.hpp"
+#include "wio.hpp"
+#include <string>
+
+namespace wdedup {
+
+/// @brief The simple format of SegmentCache.
+class SegmentCacheSimple final : public wdedup::SegmentCache {
+	/// The directory of the segment cache.
+	std::string dir;
+
+	/// The file mode of the cached profiles.
+	wdedup::FileMode mode;
+
+	/// Whether the cached profiles record the number of occurences.
+	bool counting;
+
+	/// The prefix of the cached profiles.
+	std::string prefix;
+public:
+	/// Construct the segment cache under specified directory, which
+	/// will be created if it does not exist.
+	SegmentCacheSimple(std::string dir, wdedup::FileMode mode, 
+			bool counting = false) throw (wdedup::Error);
+
+	/// Segment cache destructor.
+	virtual ~SegmentCacheSimple() noexcept {}
+
+	/// Open the cached profile of the specified key.
+	virtual std::unique_ptr<wdedup::ProfileInput> openCached(
+		const std::string& key, wdedup::SegmentOccupancy& occupancy
+		) throw (wdedup::Error) override;
+
+	/// Create the cached profile of the specified key.
+	virtual std::unique_ptr<wdedup::ProfileOutput> createCached(
+		const std::string& key, const wdedup::SegmentOccupancy& occupancy
+		) throw (wdedup::Error) override;
+};
+
+} // namespace wdedup
@@ -29,7 +29,9 @@
  */
 #pragma once
 #include "wprofile.hpp"
+#include <map>
 #include <memory>
+#include <vector>
 
 namespace wdedup {
 
@@ -52,17 +54,96 @@ struct ProgramOptions {
 	/// not be taken into consideration.
 	size_t syncDistance;
 
+	/// Whether the synchronization distance is not specified, so that
+	/// it will be taken from the tuning profile.
+	bool syncTuned;
+
 	/// Whether the working memory will be page pinned.
 	bool pagePinned;
 
+	/// Whether the working memory is resized under memory pressure.
+	bool memoryPressure;
+
+	/// The number of threads in the thread pool shared by stages.
+	size_t threads;
+
+	/// Whether the threads are pinned to the processors.
+	bool affinity;
+
+	/// Whether the next profile segment is filled while the previous
+	/// one is poured out, each with half of the working memory.
+	bool overlapPour;
+
+	/// The number of earliest non-repeating words to find.
+	size_t topN;
+
+	/// Whether all non-repeating words should be listed.
+	bool listAll;
+
+	/// Whether the number of occurences of words should be recorded.
+	bool countWords;
+
+	/// The number of most frequent words to find, where 0 means not
+	/// to find such words.
+	size_t topK;
+
+	/// Whether the number of distinct and non-repeating words should
+	/// be counted.
+	bool countUnique;
+
+	/// The number of candidates verified before merging, where 0
+	/// means the verification is disabled.
+	size_t verifyFirst;
+
 	/// Whether the profile only flag is specified.
 	bool profileOnly;
 
 	/// Whether the merge only flag is specified.
 	bool mergeOnly;
 
+	/// The directory of segment cache shared by tasks, where empty
+	/// string means the segment cache is disabled.
+	std::string cacheDir;
+
+	/// Whether the content appended to the original file since
+	/// last execution should be profiled and merged.
+	bool incremental;
+
 	/// Whether garbage collection is disabled.
 	bool disableGC;
+
+	/// The format of the statistics report printed after the task,
+	/// where empty string means the report is disabled.
+	std::string stats;
+
+	/// The path of the Prometheus textfile where the progress is
+	/// exported, where empty string means it is not exported.
+	std::string progress;
+
+	/// The path where the timeline of the task is written in Chrome
+	/// trace event format, where empty string means no tracing.
+	std::string trace;
+
+	/// The buffer sizes of files by their roles, where files of
+	/// roles not found are buffered by the default size.
+	std::map<std::string, size_t> bufferSizes;
+
+	/// The path of the tuning profile of the host, which is loaded
+	/// if it exists, where empty string means it is ignored.
+	std::string tuning;
+
+	/// Whether the program measures the tuning profile of the host,
+	/// with the workdir as the scratch directory.
+	bool tune;
+
+	/// The size of the calibration file of tuning, in unit of bytes.
+	size_t tuneSize;
+
+	/// Whether the program answers queries on a finished task.
+	bool query;
+
+	/// The words to query, read from standard input when empty.
+	std::vector<std::string> words;
 };
 
 /**
@@ -72,9 +153,19 @@ struct ProgramOptions {
  * result is the error code. When the returned value is zero, depends 
  * on whether options.run is set to true to either execute on or exit 
  * with code 0.
+ *
+ * When the first argument is "query", the remaining arguments are 
+ * parsed as the query subcommand, answering lookups of words from
+ * the working directory of a finished task. When the first argument
+ * is "tune", they are parsed as the tune subcommand, measuring the
+ * tuning profile of the host.
  */
 int argparse(int argc, char** argv, wdedup::ProgramOptions& options);
 
+/// Convert the string like "512MB" into memory size in unit of bytes.
+/// @throw std::logic_error when the string is malformed.
+size_t strsize(std::string str);
+
 /// The minimum working memory required to run the program.
 static const char* minWorkmem = "4096B";
 
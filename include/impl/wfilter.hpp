@@ -0,0 +1,84 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wfilter.hpp
+ * @author Haoran Luo
+ * @brief wdedup Bloom Filter
+ *
+ * This file defines the bloom filter of words, which is built for
+ * each block of a profile, so that looking up a word absent from the
+ * block could be answered without reading the block.
+ *
+ * Please notice the filter is persisted, so the hash function must
+ * be stable across builds and platforms, and std::hash is not used.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace wdedup {
+
+/// Number of bits used by each item in the filter.
+static const size_t filterBitsPerItem = 10;
+
+/// Number of probes performed for each item in the filter.
+static const size_t filterProbes = 7;
+
+/// Retrieve the size of the filter holding the items, in bytes.
+inline size_t filterSize(size_t items) noexcept {
+	size_t bytes = (items * filterBitsPerItem + 7) / 8;
+	return bytes < 8? 8 : bytes;
+}
+
+/// Hash the word for the filter (FNV-1a with a final avalanche).
+inline uint64_t filterHash(const char* word, size_t len) noexcept {
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(size_t i = 0; i < len; ++ i) {
+		h ^= (unsigned char)word[i];
+		h *= 0x100000001b3ull;
+	}
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+/// Add the hashed word into the filter of specified size.
+inline void filterAdd(unsigned char* filter, size_t size, 
+		uint64_t hash) noexcept {
+	uint64_t delta = (hash >> 32) | (hash << 32);
+	size_t bits = size * 8;
+	for(size_t i = 0; i < filterProbes; ++ i, hash += delta)
+		filter[(hash % bits) / 8] |= (unsigned char)(1 << (hash % 8));
+}
+
+/// Test whether the hashed word might be inside the filter.
+inline bool filterTest(const unsigned char* filter, size_t size, 
+		uint64_t hash) noexcept {
+	uint64_t delta = (hash >> 32) | (hash << 32);
+	size_t bits = size * 8;
+	for(size_t i = 0; i < filterProbes; ++ i, hash += delta)
+		if(!(filter[(hash % bits) / 8] & (1 << (hash % 8)))) return false;
+	return true;
+}
+
+} // namespace wdedup
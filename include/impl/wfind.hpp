@@ -0,0 +1,157 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wfind.hpp
+ * @author Haoran Luo
+ * @brief wdedup Final Profile Consumers
+ *
+ * This file defines the scan consumers of the stages finding words in
+ * the final profile. Each of them keeps its own local result of each 
+ * worker, and reduces them after scanning, so that they could either 
+ * be scanned alone by their stages, or be registered on a scan plan
+ * to be served by a single scan.
+ */
+#pragma once
+#include "impl/wscan.hpp"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <utility>
+
+namespace wdedup {
+
+/// Keeps the local minimum of each worker, and shares the lowest
+/// occurence found so far among workers for pruning blocks.
+struct FindFirstConsumer : public wdedup::ScanConsumer {
+	/// The local result of a worker.
+	struct Local {
+		std::string word;
+		fileoff_t occur;
+		Local() noexcept: word(), occur(ProfileBlock::none) {}
+	};
+	std::vector<Local> locals;
+
+	/// The lowest occurence found by all workers.
+	std::atomic<fileoff_t> bound;
+
+	FindFirstConsumer(size_t workers) noexcept: 
+		locals(workers), bound(ProfileBlock::none) {}
+
+	virtual bool accept(size_t, const wdedup::ProfileBlock&) 
+			noexcept override;
+
+	virtual void consume(size_t, wdedup::ProfileItem) override;
+
+	/// Reduce the earliest singular word, or empty string if none.
+	std::string result() const;
+};
+
+/// Keeps a bounded max-heap of the earliest singular items for each
+/// worker, and shares the lowest heap top among the full heaps, as no
+/// item later than it could be among the final N items.
+struct FindTopNConsumer : public wdedup::ScanConsumer {
+	/// The entry inside the heap, ordered by their occurence.
+	struct Entry {
+		fileoff_t occur;
+		std::string word;
+		bool operator<(const Entry& e) const noexcept {
+			return occur < e.occur;
+		}
+	};
+	std::vector<std::vector<Entry>> heaps;
+
+	/// The number of items to find.
+	const size_t n;
+
+	/// The lowest heap top among the full heaps.
+	std::atomic<fileoff_t> bound;
+
+	FindTopNConsumer(size_t workers, size_t n) noexcept: 
+		heaps(workers), n(n), bound(ProfileBlock::none) {}
+
+	virtual bool accept(size_t, const wdedup::ProfileBlock&) 
+			noexcept override;
+
+	virtual void consume(size_t, wdedup::ProfileItem) override;
+
+	/// Reduce the earliest n singular words, in order of occurence.
+	std::vector<std::string> result();
+};
+
+/// Keeps a bounded heap of the most frequent items for each worker,
+/// and shares the lowest count among the full heaps, as no item less
+/// frequent than it could be among the final K items.
+struct FindTopKConsumer : public wdedup::ScanConsumer {
+	/// The entry inside the heap, the worst entry will be on the top.
+	struct Entry {
+		size_t count;
+		std::string word;
+		bool operator<(const Entry& e) const noexcept {
+			return count > e.count || (count == e.count && word < e.word);
+		}
+	};
+	std::vector<std::vector<Entry>> heaps;
+
+	/// The number of items to find.
+	const size_t k;
+
+	/// The lowest count among the full heaps.
+	std::atomic<size_t> bound;
+
+	/// Whether a block without recorded count has been met.
+	std::atomic<bool> uncounted;
+
+	FindTopKConsumer(size_t workers, size_t k) noexcept: 
+		heaps(workers), k(k), bound(0), uncounted(false) {}
+
+	virtual bool accept(size_t, const wdedup::ProfileBlock&) 
+			noexcept override;
+
+	virtual void consume(size_t, wdedup::ProfileItem) override;
+
+	/// Reduce the most frequent k words with their counts.
+	/// @throw wdedup::Error if the count of any item is not recorded.
+	std::vector<std::pair<std::string, size_t>> result(
+			const std::string& path) throw (wdedup::Error);
+};
+
+/// Counts the distinct and singular words of each worker.
+struct CountConsumer : public wdedup::ScanConsumer {
+	/// The local counters of a worker.
+	struct Local {
+		size_t distinct, singular;
+		Local() noexcept: distinct(0), singular(0) {}
+	};
+	std::vector<Local> locals;
+
+	CountConsumer(size_t workers) noexcept: locals(workers) {}
+
+	virtual bool accept(size_t, const wdedup::ProfileBlock&) 
+			noexcept override { return true; }
+
+	virtual void consume(size_t, wdedup::ProfileItem) override;
+
+	/// Reduce the number of distinct words and singular words.
+	std::pair<size_t, size_t> result() const noexcept;
+};
+
+} // namespace wdedup
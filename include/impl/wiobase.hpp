@@ -29,14 +29,16 @@
  */
 #pragma once
 #include <cstddef>
+#include <memory>
 #include <vector>
 #include <functional>
 #include "wio.hpp"
 
 namespace wdedup {
 
-/// Buffer size of the read buffer, usually equals to a page size or
-/// a sector size so that I/O transmissions could be optimized.
+/// Default buffer size of the read and write buffer, usually equals to
+/// a page size or a sector size so that I/O transmissions could be 
+/// optimized. It could be overriden per role by FileMode::buffers.
 /// TODO(haoran.luo): try to fetch the page size or sector size using
 /// CMake's configure_file() headers.
 static const size_t bufsiz = 4096;
@@ -49,9 +51,10 @@ static const size_t bufsiz = 4096;
  * through decorator patterns.
  */
 struct SequentialFileBase : public SequentialFile::Impl {
-	/// @brief Open a file under the given path.
+	/// @brief Open a file under the given path, buffered by the
+	/// specified size of buffer.
 	SequentialFileBase(const char*, std::function<void(int)>, 
-		fileoff_t) throw (wdedup::Error);
+		fileoff_t, size_t bufsize = bufsiz) throw (wdedup::Error);
 
 	/// Close the file when the object get destructed.
 	virtual ~SequentialFileBase() noexcept;
@@ -70,8 +73,17 @@ private:
 	// Check whether it is end of file now.
 	virtual bool checkeof() noexcept;
 
+	/// The size of the read buffer.
+	const size_t bufsize;
+
 	/// The buffer storing the fetched content.
-	char readbuf[bufsiz];
+	std::unique_ptr<char[]> readbuf;
+
+	/// The size of the regular file when it is opened. Reaching it
+	/// is taken as end of file without reading again, so content 
+	/// appended after opening (like the growing original file) is 
+	/// only seen by files opened afterwards.
+	fileoff_t filesize;
 
 	/// The offset of data in the read buffer.
 	size_t readoff;
@@ -140,8 +152,10 @@ private:
  * of reduced syscall.
  */
 struct AppendFileBuffer : public AppendFileBase {
-	/// @brief Open or create a log file under the given path.
-	AppendFileBuffer(const char*, std::function<void(int)>) throw (wdedup::Error);
+	/// @brief Open or create a file under the given path, buffered
+	/// by the specified size of buffer.
+	AppendFileBuffer(const char*, std::function<void(int)>, 
+		size_t bufsize = bufsiz) throw (wdedup::Error);
 
 	/// Close the file when the object get destructed.
 	virtual ~AppendFileBuffer() noexcept {}
@@ -152,8 +166,11 @@ struct AppendFileBuffer : public AppendFileBase {
 	/// No synchronization for such file, and no delegating as it is the base.
 	virtual void sync() throw(wdedup::Error) override;
 private:
+	/// The size of the write buffer.
+	const size_t bufsize;
+
 	/// The buffer buffering the content to write.
-	char writebuf[bufsiz];
+	std::unique_ptr<char[]> writebuf;
 
 	/// The length of data in the write buffer.
 	size_t writelen;
@@ -49,6 +49,11 @@ struct MergePlannerDP : public MergePlanner {
 
 	/// Implements the push function.
 	virtual void push(wdedup::MergeSegment) override {}
+
+	/// Retrieve the plans to be executed, in order.
+	const std::vector<wdedup::MergePlan>& schedule() const noexcept {
+		return plans;
+	}
 private:
 	/// The generated plan.
 	std::vector<wdedup::MergePlan> plans;
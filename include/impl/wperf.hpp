@@ -0,0 +1,100 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wperf.hpp
+ * @author Haoran Luo
+ * @brief wdedup Hardware Performance Counters
+ *
+ * This file defines the hardware performance counters of the process,
+ * opened with perf_event_open(2) for user space only, on each thread
+ * of the process, so that the cache misses, TLB misses, branch misses
+ * and instructions per cycle of a stage could be measured without an
+ * external profiler.
+ *
+ * The counters might be unavailable, when perf_event_paranoid forbids
+ * the access, when running inside a container without the syscall, or
+ * on a virtual machine without PMU. Then nothing is counted and the 
+ * reason is kept for reporting. Events unsupported by the processor
+ * are left out individually.
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wdedup {
+
+/// @brief The hardware events counted.
+enum class PerfEvent : size_t {
+	cycles = 0, instructions, cacheMisses, dtlbMisses, branchMisses, count
+};
+
+/// @brief The values of the counters, summed over threads.
+struct PerfSample {
+	/// The value of each event, scaled by the time that the event was
+	/// actually counted when the counters are multiplexed.
+	double values[(size_t)wdedup::PerfEvent::count];
+
+	/// Whether each event is counted.
+	bool counted[(size_t)wdedup::PerfEvent::count];
+
+	/// The counts accumulated since the specified sample.
+	wdedup::PerfSample operator-(const wdedup::PerfSample&) const noexcept;
+};
+
+/// @brief The hardware counters on each thread of the process.
+class PerfCounters {
+	/// The file descriptors of the counters, each thread has a group
+	/// led by its first counter.
+	std::vector<std::vector<int>> groups;
+
+	/// The thread of each group.
+	std::vector<int> tids;
+
+	/// The events that could be opened, in order of group members.
+	std::vector<wdedup::PerfEvent> events;
+
+	/// The reason that the counters are unavailable.
+	std::string reason;
+public:
+	/// Open the counters on the threads currently in the process. The
+	/// threads created afterwards are not counted.
+	PerfCounters() noexcept;
+
+	/// Close the counters.
+	~PerfCounters() noexcept;
+
+	/// Whether any counter is available.
+	bool available() const noexcept { return !groups.empty(); }
+
+	/// The reason that the counters are unavailable.
+	const std::string& unavailable() const noexcept { return reason; }
+
+	/// Read the current values of the counters, summed over threads,
+	/// or of the calling thread only if thread is specified.
+	wdedup::PerfSample sample(bool thread = false) const noexcept;
+
+	/// Retrieve the name of the event in the report.
+	static const char* name(wdedup::PerfEvent) noexcept;
+};
+
+} // namespace wdedup
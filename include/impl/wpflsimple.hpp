@@ -26,14 +26,46 @@
  *
  * This file defines the I/O simple implementation. This implementation
  * requires a single file, and "ProfileItem"s are stored as sorted 
- * K-V pairs in the profile.
+ * K-V pairs in the profile. Each item is the word followed by a flag,
+ * which is 0 for single occurence item followed by its occurence, 2 
+ * for repeated item followed by its number of occurences in variable
+ * length, or other value for repeated item without such number.
+ *
+ * The block summaries of the profile are stored in a sidecar index
+ * file, named after the profile with an ".idx" suffix. And the bloom 
+ * filters of the blocks are stored in another sidecar filter file,
+ * named after the profile with an ".blm" suffix.
  */
 #pragma once
 #include "wprofile.hpp"
 #include "wio.hpp"
+#include <memory>
+#include <vector>
+#include <cstdint>
 
 namespace wdedup {
 
+/// The size of a profile block, in unit of bytes. A new block will
+/// be started once the current block exceeds such size.
+static const size_t profileBlockSize = 64 * 1024;
+
+/// Retrieve the path of the index file of the specified profile.
+inline std::string profileIndexPath(const std::string& path) {
+	return path + ".idx";
+}
+
+/// Retrieve the path of the filter file of the specified profile.
+inline std::string profileFilterPath(const std::string& path) {
+	return path + ".blm";
+}
+
+/// Read the index file of the specified profile, in simple format.
+std::vector<wdedup::ProfileBlock> profileIndexSimple(
+	std::string path, wdedup::FileMode mode) throw (wdedup::Error);
+
+/// Remove the specified profile and its sidecar files if they exist.
+void profileRemoveSimple(const std::string& path) noexcept;
+
 /// @brief The simple format of ProfileInput.
 class ProfileInputSimple final : public wdedup::ProfileInput {
 	/// The simple profile input.
@@ -76,13 +108,34 @@ public:
 class ProfileOutputSimple final : public wdedup::ProfileOutput {
 	/// The simple profile output.
 	wdedup::AppendFile output;
+
+	/// The index output storing the block summaries, and the filter
+	/// output storing the bloom filters of blocks. Both are nullptr
+	/// when the sidecar files are not written.
+	std::unique_ptr<wdedup::AppendFile> index, filter;
+
+	/// The block that is currently being written.
+	wdedup::ProfileBlock block;
+
+	/// The hashes of words inside current block.
+	std::vector<uint64_t> hashes;
+
+	/// Whether the number of occurences of repeated item is written.
+	bool counting;
+
+	/// Write out the summary of current block.
+	void flushBlock() throw (wdedup::Error);
 public:
 	/**
 	 * Construct a profile output writing specified path. The file
-	 * will be written in simple format.
+	 * will be written in simple format. The number of occurences of
+	 * repeated items will be written only if counting is specified.
+	 * The index and filter sidecar files will be written only if 
+	 * indexed is specified, otherwise the profile could only be read
+	 * by wdedup::ProfileInputSimple.
 	 */
-	ProfileOutputSimple(std::string path,
-		wdedup::FileMode mode) throw (wdedup::Error);
+	ProfileOutputSimple(std::string path, wdedup::FileMode mode, 
+		bool counting = false, bool indexed = true) throw (wdedup::Error);
 
 	/// Profile output destructor.
 	virtual ~ProfileOutputSimple() noexcept {}
@@ -94,4 +147,41 @@ public:
 	virtual size_t close() throw (wdedup::Error) override;
 };
 
+/**
+ * @brief The simple format of ProfileLookup.
+ *
+ * The profile and its filter file are mapped into memory, and the
+ * index file is loaded on construction. Looking up a word will
+ * locate the block by the sparse index, test the bloom filter of
+ * the block, and scan the block only if the filter passes.
+ */
+class ProfileLookupSimple final : public wdedup::ProfileLookup {
+	/// The path of the profile, for reporting errors.
+	std::string path;
+
+	/// The block summaries of the profile.
+	std::vector<wdedup::ProfileBlock> blocks;
+
+	/// The offset of the bloom filter of each block.
+	std::vector<size_t> filters;
+
+	/// The mapped profile and its size.
+	const char* profile; size_t profileSize;
+
+	/// The mapped filter file and its size.
+	const unsigned char* filter; size_t filterSize;
+public:
+	/// Construct a profile lookup on the specified path. The file
+	/// is assumed to be simple formatted.
+	ProfileLookupSimple(std::string path,
+		wdedup::FileMode mode) throw (wdedup::Error);
+
+	/// Profile lookup destructor, the mapping will be released.
+	virtual ~ProfileLookupSimple() noexcept;
+
+	/// Attempt to look up the word in the profile.
+	virtual bool find(const std::string& word,
+		wdedup::ProfileItem& item) const throw (wdedup::Error) override;
+};
+
 } // namespace wdedup
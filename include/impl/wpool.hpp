@@ -0,0 +1,140 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wpool.hpp
+ * @author Haoran Luo
+ * @brief wdedup Work-Stealing Thread Pool
+ *
+ * This file defines the thread pool shared by every stage of a task,
+ * so that the threads are created once and stay busy across stages.
+ * Each worker owns a task queue, it takes the lastly submitted task
+ * from its own queue, and steals the earliest submitted task from the
+ * queues of other workers when its own queue is empty.
+ *
+ * The thread creating the pool is also a worker of the pool, however
+ * it only runs tasks while it is waiting for a task group.
+ */
+#pragma once
+#include "wtypes.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wdedup {
+
+/// @brief The work-stealing thread pool.
+class ThreadPool {
+	/// The worker owning a task queue.
+	struct Worker {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+		std::thread thread;
+	};
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	/// Number of tasks that have been submitted but not taken.
+	std::atomic<size_t> pending;
+
+	/// The next worker to place the tasks submitted from outside.
+	std::atomic<size_t> next;
+
+	/// The idle workers wait on the condition for tasks.
+	std::mutex idleMutex;
+	std::condition_variable idle;
+	bool stopping;
+
+	/// The worker loop of the background threads.
+	void loop(size_t self) noexcept;
+
+	/// Stop and join the background threads.
+	void stop() noexcept;
+public:
+	/**
+	 * Construct the pool with the specified number of workers, the
+	 * constructing thread counted as one of them. When affinity is 
+	 * specified, each worker will be pinned to a processor available
+	 * to the process, in turn.
+	 */
+	ThreadPool(size_t threads, bool affinity = false) throw (wdedup::Error);
+
+	/// Stop and join the background threads. All task groups must 
+	/// have been waited before the pool is destroyed.
+	~ThreadPool() noexcept;
+
+	/// Retrieve the number of workers.
+	size_t size() const noexcept { return workers.size(); }
+
+	/// Submit a task to the pool. The task will be placed in the queue
+	/// of current worker, if it is submitted by a worker of the pool.
+	void submit(std::function<void()> task);
+
+	/// Run a task taken from the queue of current worker, or stolen
+	/// from other workers. False is returned if there's no task.
+	bool runOne() noexcept;
+};
+
+/**
+ * @brief Tracks a group of tasks submitted to the pool.
+ *
+ * The thread waiting for the group runs other tasks of the pool while
+ * the group is not completed, so that waiting inside a task will not
+ * exhaust the workers. The first error raised by the tasks will be 
+ * rethrown by waiting.
+ */
+class TaskGroup {
+	/// The pool executing the tasks.
+	wdedup::ThreadPool& pool;
+
+	/// Number of tasks that have not been completed.
+	size_t remaining;
+
+	/// The first error raised by the tasks.
+	std::exception_ptr error;
+
+	/// The waiter waits on the condition for completion.
+	std::mutex mutex;
+	std::condition_variable done;
+
+	/// Wait for all tasks without rethrowing errors.
+	void join() noexcept;
+public:
+	/// Construct an empty group on the pool.
+	TaskGroup(wdedup::ThreadPool& pool) noexcept: 
+		pool(pool), remaining(0), error() {}
+
+	/// Wait for all tasks before the group is destroyed.
+	~TaskGroup() noexcept { join(); }
+
+	/// Submit a task to the pool as part of the group.
+	void run(std::function<void()> task);
+
+	/// Wait for all tasks, and rethrow the first error if any.
+	void wait();
+};
+
+} // namespace wdedup
@@ -0,0 +1,74 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wpressure.hpp
+ * @author Haoran Luo
+ * @brief wdedup Memory Pressure Governor
+ *
+ * This file defines the memory governor watching the cgroup v2 memory
+ * controller of the process. The budget is halved when the memory of 
+ * the cgroup is under pressure or close to its memory.high, and is
+ * doubled when there's neither pressure nor shortage of headroom,
+ * bounded by the minimum size and the size of the working memory.
+ */
+#pragma once
+#include "impl/wbudget.hpp"
+#include <ostream>
+#include <string>
+
+namespace wdedup {
+
+/// @brief The memory governor reading the cgroup v2 memory controller.
+class MemoryGovernorCgroup final : public wdedup::MemoryGovernor {
+	/// The directory of the cgroup, empty if it is not found.
+	std::string cgroup;
+
+	/// The minimum size of the budget.
+	size_t minimum;
+
+	/// The stream to report the decisions, nullptr if not reported.
+	std::ostream* report;
+public:
+	/// The "some avg10" pressure percentage to shrink the budget.
+	static constexpr double shrinkPressure = 10.0;
+
+	/// The "some avg10" pressure percentage below which the budget 
+	/// could be grown.
+	static constexpr double growPressure = 1.0;
+
+	/**
+	 * Construct the governor on the cgroup of the process, looked up 
+	 * from /proc/self/cgroup under the cgroup v2 mount, or on the 
+	 * specified cgroup directory if it is not empty.
+	 */
+	MemoryGovernorCgroup(size_t minimum, std::ostream* report,
+		std::string cgroup = "") noexcept;
+
+	/// Whether the memory controller of the cgroup is available.
+	bool available() const noexcept { return !cgroup.empty(); }
+
+	/// Advise the size by the pressure and headroom of the cgroup.
+	virtual size_t advise(size_t current, 
+		size_t capacity) noexcept override;
+};
+
+} // namespace wdedup
@@ -0,0 +1,74 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wprobe.hpp
+ * @author Haoran Luo
+ * @brief wdedup Static Tracepoints
+ *
+ * This file defines the USDT (user-level statically defined tracing)
+ * probes of wdedup, under the provider "wdedup", which could be
+ * attached by bpftrace, perf or SystemTap in production, like:
+ *
+ * ```
+ * bpftrace -e 'usdt:./wdedup:wdedup:merge__end { @[arg0] = arg1; }'
+ * ```
+ *
+ * The probes are expanded by the header-only sys/sdt.h into a nop 
+ * instruction and a note section entry, so there's no overhead when
+ * no probe is attached. When sys/sdt.h is absent or the probes are
+ * disabled with WDEDUP_DISABLE_USDT, the probes are expanded into 
+ * nothing at all.
+ *
+ * The probes and their arguments are:
+ * - dedup__insert(offset, length): a new word is inserted.
+ * - dedup__repeat(offset, length): a word is found already inserted.
+ * - dedup__full(offset, length): the segment has no room for a word.
+ * - segment__start(id, start): wprof starts filling a segment.
+ * - segment__end(id, start, end, size): a segment is persisted.
+ * - merge__start(id, left, right): wmerge starts executing a plan.
+ * - merge__end(id, size): a merged profile is persisted.
+ * - log__sync__start(bytes), log__sync__end(bytes): AppendFileLog
+ *   writes out and fsyncs the buffered log.
+ * - file__refill(fd, offset, bytes): SequentialFileBase refills its
+ *   buffer from the file.
+ */
+#pragma once
+
+#if !defined(WDEDUP_DISABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define WDEDUP_USDT 1
+#endif
+#endif
+
+#ifdef WDEDUP_USDT
+#define WDEDUP_PROBE1(name, a) DTRACE_PROBE1(wdedup, name, a)
+#define WDEDUP_PROBE2(name, a, b) DTRACE_PROBE2(wdedup, name, a, b)
+#define WDEDUP_PROBE3(name, a, b, c) DTRACE_PROBE3(wdedup, name, a, b, c)
+#define WDEDUP_PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(wdedup, name, a, b, c, d)
+#else
+#define WDEDUP_PROBE1(name, a) do {} while(0)
+#define WDEDUP_PROBE2(name, a, b) do {} while(0)
+#define WDEDUP_PROBE3(name, a, b, c) do {} while(0)
+#define WDEDUP_PROBE4(name, a, b, c, d) do {} while(0)
+#endif
@@ -0,0 +1,139 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wprogress.hpp
+ * @author Haoran Luo
+ * @brief wdedup Progress Metrics
+ *
+ * This file defines the progress of a task, which tracks the bytes of
+ * the original file that have been consumed, the current segment and
+ * the merges that have been done against the merge plan. The progress
+ * could be exported periodically as a Prometheus textfile, which is
+ * replaced atomically, along with the current throughput and the 
+ * estimated remaining time of current stage, so that the monitoring
+ * could alert on stalled tasks and regression of throughput.
+ */
+#pragma once
+#include "wtypes.hpp"
+#include "wdedup.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wdedup {
+
+/// The default interval between exports of the progress.
+static constexpr std::chrono::milliseconds progressInterval(10000);
+
+/// @brief The progress of a task, tracked by the stages.
+class ProgressReport {
+	/// The name of current stage, which must be a string literal.
+	std::atomic<const char*> current;
+
+	/// The size of the original file and bytes consumed by wprof.
+	std::atomic<uint64_t> fileSize, consumed;
+
+	/// The id of the segment being profiled.
+	std::atomic<uint64_t> segment;
+
+	/// The number of planned and done merges, and their costs.
+	std::atomic<uint64_t> mergesPlanned, mergesDone;
+	std::atomic<uint64_t> costPlanned, costDone;
+
+	/// The time when the task started.
+	std::chrono::steady_clock::time_point started;
+
+	/// The path of the textfile, empty if not exported.
+	std::string path;
+
+	/// The interval between exports.
+	std::chrono::milliseconds interval;
+
+	/// The exporting thread, and the states for stopping it.
+	std::thread exporter;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping;
+
+	/// The I/O bytes and the time of last export.
+	uint64_t lastBytes;
+	std::chrono::steady_clock::time_point lastExport;
+
+	/// The mark of work seen by last export, and the unix time of
+	/// the latest export seeing the mark advanced.
+	uint64_t lastMark; double lastAdvanced;
+
+	/// The measure of work estimating the remaining time, with the
+	/// work done and the time when the measure is first seen.
+	const char* baseStage; int baseKind; uint64_t baseWork;
+	std::chrono::steady_clock::time_point baseTime;
+
+	/// Retrieve the measure of work of current stage, which is 1 for
+	/// the bytes of the original file, 2 for the cost of merges and 
+	/// 0 if the remaining time could not be estimated.
+	int measure(uint64_t& done, uint64_t& total) const noexcept;
+public:
+	/// Construct the progress, which is not exported until started.
+	ProgressReport() noexcept;
+
+	/// Stop exporting, with a final export of the progress.
+	~ProgressReport() noexcept;
+
+	/// Start exporting the progress to the specified textfile at the
+	/// specified interval, and the textfile will be written at once.
+	void start(std::string path, std::chrono::milliseconds interval) 
+		throw (wdedup::Error);
+
+	/// Enter the specified stage, the name must be a string literal.
+	void stage(const char* name) noexcept;
+
+	/// Record the size of the original file being profiled.
+	void original(uint64_t size) noexcept { fileSize.store(size); }
+
+	/// Record the offset of the original file that has been consumed.
+	void consume(uint64_t offset) noexcept {
+		consumed.store(offset, std::memory_order_relaxed);
+	}
+
+	/// Record the id of the segment that is being profiled.
+	void profile(uint64_t id) noexcept { segment.store(id); }
+
+	/// Record the merge plan that is about to be executed.
+	void plan(const std::vector<wdedup::MergePlan>& plans) noexcept;
+
+	/// Record that a planned merge has been done.
+	void merged(const wdedup::MergePlan& plan) noexcept;
+
+	/// Render the progress in Prometheus text exposition format.
+	std::string render() noexcept;
+
+	/// Write out the textfile, which is written to a temporary file 
+	/// beside it and renamed over it.
+	void write() throw (wdedup::Error);
+};
+
+} // namespace wdedup
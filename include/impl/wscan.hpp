@@ -0,0 +1,134 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wscan.hpp
+ * @author Haoran Luo
+ * @brief wdedup Parallel Block Scanning
+ *
+ * This file defines the parallel block scanning that is shared by
+ * the stages scanning the final profile. The blocks of the profile
+ * are claimed by multiple workers, each of them reading the profile
+ * through its own profile input and keeping its own local result,
+ * which are reduced by the caller after scanning.
+ *
+ * Multiple consumers could also be registered on a scan plan, so that
+ * they are served by a single scan, where each block is read once and
+ * its items are fanned out to every consumer accepting it.
+ */
+#pragma once
+#include "wconfig.hpp"
+#include "wprofile.hpp"
+#include <string>
+#include <vector>
+
+namespace wdedup {
+
+/// @brief Defines the consumer of parallel block scanning.
+struct ScanConsumer {
+	/// Virtual destructor for pure virtual class.
+	virtual ~ScanConsumer() noexcept {}
+
+	/// Test whether the block should be scanned by the worker. The
+	/// consumer could prune the block by its summary here.
+	virtual bool accept(size_t worker,
+			const wdedup::ProfileBlock&) noexcept = 0;
+
+	/// Consume an item inside the accepted block. Items of a block
+	/// are always consumed by the same worker in their order.
+	virtual void consume(size_t worker, wdedup::ProfileItem) = 0;
+};
+
+/// Order the blocks by ascending minimum occurence, so that blocks
+/// that might contain the earlier singular items are visited first.
+std::vector<size_t> occurOrder(
+	const std::vector<wdedup::ProfileBlock>& blocks) noexcept;
+
+/// Order the blocks by descending maximum number of occurences, so
+/// that blocks that might contain the more frequent items are visited
+/// first.
+std::vector<size_t> countOrder(
+	const std::vector<wdedup::ProfileBlock>& blocks) noexcept;
+
+/**
+ * @brief Scans the blocks of a profile with multiple workers.
+ *
+ * The blocks are claimed by the workers following the specified
+ * order, and a worker continues reading from its current input if
+ * its next claimed block is adjacent to the previous one.
+ *
+ * @param[inout] cfg the configuration of current task.
+ * @param[in] path the profile to scan under the workdir.
+ * @param[in] blocks the block summaries of the profile.
+ * @param[in] order the indices of blocks to visit, in visiting order.
+ * @param[in] workers the number of workers, at least 1.
+ * @param[in] consumer the consumer receiving the items.
+ * @throw wdedup::Error when any of the worker fails to read. Other
+ * workers will stop claiming blocks on such failure.
+ */
+void wscan(wdedup::Config& cfg, const std::string& path,
+	const std::vector<wdedup::ProfileBlock>& blocks,
+	const std::vector<size_t>& order, size_t workers,
+	wdedup::ScanConsumer& consumer) throw (wdedup::Error);
+
+/**
+ * @brief Fans the items out to multiple consumers in a single scan.
+ *
+ * A block is read if any of the registered consumers accepts it, and
+ * its items are consumed only by those that have accepted it. The
+ * consumers must be registered before scanning, and they must outlive
+ * the plan.
+ */
+class ScanPlan final : public wdedup::ScanConsumer {
+	/// The registered consumers.
+	std::vector<wdedup::ScanConsumer*> consumers;
+
+	/// The consumers that accepted the current block of each worker.
+	std::vector<std::vector<wdedup::ScanConsumer*>> accepted;
+public:
+	/// Construct an empty plan for the specified number of workers.
+	ScanPlan(size_t workers) noexcept: consumers(), 
+		accepted(workers == 0? 1 : workers) {}
+
+	/// Register a consumer on the plan.
+	void add(wdedup::ScanConsumer& consumer) noexcept {
+		consumers.push_back(&consumer);
+	}
+
+	/// Test whether the plan has registered any consumer.
+	bool empty() const noexcept { return consumers.empty(); }
+
+	/// The block is accepted if any of the consumers accepts it.
+	virtual bool accept(size_t worker,
+			const wdedup::ProfileBlock&) noexcept override;
+
+	/// Consume an item by every consumer accepting current block.
+	virtual void consume(size_t worker, wdedup::ProfileItem) override;
+
+	/// Scan the profile with the consumers, see wdedup::wscan.
+	void scan(wdedup::Config& cfg, const std::string& path,
+		const std::vector<wdedup::ProfileBlock>& blocks,
+		const std::vector<size_t>& order) throw (wdedup::Error) {
+		wdedup::wscan(cfg, path, blocks, order, accepted.size(), *this);
+	}
+};
+
+} // namespace wdedup
@@ -0,0 +1,205 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wstats.hpp
+ * @author Haoran Luo
+ * @brief wdedup Performance Statistics
+ *
+ * This file defines the performance statistics of a task. The I/O 
+ * layer and the stages bump process-wide and per-thread counters, 
+ * which are cheap relaxed atomic additions, and a statistics report 
+ * takes snapshots of the counters around each stage and each merge 
+ * (of the thread running the merge only), along with their
+ * wall time and CPU time, so that the report tells where the time 
+ * and I/O went. The hardware counters of the process are sampled
+ * around them as well if they are opened.
+ */
+#pragma once
+#include "wtypes.hpp"
+#include "impl/wperf.hpp"
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wdedup {
+
+/// @brief The snapshot of the process-wide counters.
+struct StatsSnapshot {
+	/// Bytes read from and written to files.
+	uint64_t bytesRead, bytesWritten;
+
+	/// Number of read, write and fsync system calls.
+	uint64_t readCalls, writeCalls, syncCalls;
+
+	/// Number of profile items read from and written to profiles.
+	uint64_t itemsRead, itemsWritten;
+
+	/// Number of words profiled, and how many of them are repeated
+	/// inside their segments.
+	uint64_t tokens, dedupHits;
+
+	/// Number of profile blocks scanned and skipped by scanning.
+	uint64_t blocksScanned, blocksSkipped;
+
+	/// The counters accumulated since the specified snapshot.
+	StatsSnapshot operator-(const StatsSnapshot& s) const noexcept;
+
+	/// The counters accumulated by both snapshots.
+	StatsSnapshot operator+(const StatsSnapshot& s) const noexcept;
+};
+
+/// @brief The process-wide or per-thread counters.
+struct StatsCounters {
+	std::atomic<uint64_t> bytesRead, bytesWritten;
+	std::atomic<uint64_t> readCalls, writeCalls, syncCalls;
+	std::atomic<uint64_t> itemsRead, itemsWritten;
+	std::atomic<uint64_t> tokens, dedupHits;
+	std::atomic<uint64_t> blocksScanned, blocksSkipped;
+
+	/// Take the snapshot of current counters.
+	StatsSnapshot snapshot() const noexcept;
+};
+
+/// Retrieve the process-wide counters.
+inline wdedup::StatsCounters& statsCounters() noexcept {
+	static wdedup::StatsCounters counters;
+	return counters;
+}
+
+/// Retrieve the counters of the calling thread.
+inline wdedup::StatsCounters& statsThreadCounters() noexcept {
+	static thread_local wdedup::StatsCounters counters;
+	return counters;
+}
+
+/// Bump the specified counter of the process and the calling thread.
+inline void statsAdd(std::atomic<uint64_t> wdedup::StatsCounters::* counter,
+	uint64_t value) noexcept {
+	(statsCounters().*counter).fetch_add(value, std::memory_order_relaxed);
+	(statsThreadCounters().*counter).fetch_add(
+		value, std::memory_order_relaxed);
+}
+
+/// @brief The kind of the measured entry.
+enum class StatsKind { stage, segment, merge };
+
+/// @brief The measurement of a stage, a segment or a merge.
+struct StatsEntry {
+	/// The name of the stage, the segment or the merge.
+	std::string name;
+
+	/// The wall time and CPU time, in unit of seconds.
+	double wall, cpu;
+
+	/// The counters accumulated while the entry is measured.
+	wdedup::StatsSnapshot counters;
+
+	/// The measurements specific to the entry.
+	std::vector<std::pair<std::string, double>> extra;
+};
+
+/**
+ * @brief The statistics report of a task.
+ *
+ * The stages, segments and merges are measured by scopes, and the
+ * report is written as a JSON document after the task has been done.
+ */
+class StatsReport {
+	/// The measured stages, segments and merges.
+	std::vector<wdedup::StatsEntry> stages, segments, merges;
+
+	/// The mutex protecting the entries.
+	std::mutex mutex;
+
+	/// The hardware counters, nullptr if they are not opened.
+	std::unique_ptr<wdedup::PerfCounters> perf;
+public:
+	/// @brief Measures an entry until it is destroyed.
+	class Scope {
+		/// The report to place the entry, nullptr if disabled.
+		wdedup::StatsReport* report;
+
+		/// The kind of the entry.
+		wdedup::StatsKind kind;
+
+		/// The entry being measured, accumulated by the measured spans.
+		wdedup::StatsEntry entry;
+
+		/// Whether a span is being measured.
+		bool running;
+
+		/// The wall time and CPU time when the span starts.
+		std::chrono::steady_clock::time_point wall; double cpu;
+
+		/// The counters when the span starts.
+		wdedup::StatsSnapshot start;
+
+		/// The hardware counters when the span starts, and those 
+		/// accumulated by the measured spans.
+		wdedup::PerfSample perfStart, perfTotal;
+	public:
+		/**
+		 * Start measuring, nothing is measured if report is nullptr.
+		 *
+		 * A stage is measured on the whole process. A segment or a 
+		 * merge is measured on the calling thread only, since others 
+		 * might run beside it on other threads. When its work moves to
+		 * another thread, it should be suspended on the calling thread
+		 * and resumed on the other one.
+		 */
+		Scope(wdedup::StatsReport* report, std::string name, 
+			wdedup::StatsKind kind = wdedup::StatsKind::stage) noexcept;
+
+		/// Place the measurement into the report.
+		~Scope() noexcept;
+
+		/// Stop measuring the span on the calling thread.
+		void suspend() noexcept;
+
+		/// Start measuring another span on the calling thread.
+		void resume() noexcept;
+
+		/// Record a measurement specific to the entry.
+		void extra(std::string key, double value) noexcept;
+	};
+
+	/// Open the hardware counters on the threads currently in the 
+	/// process, which are sampled around the scopes started later.
+	void hardware() noexcept;
+
+	/// Write out the report as a JSON document.
+	void write(std::ostream&) const;
+};
+
+/// Retrieve the CPU time consumed by the process, in seconds.
+double statsCpuTime() noexcept;
+
+/// Retrieve the CPU time consumed by the calling thread, in seconds.
+double statsThreadCpuTime() noexcept;
+
+} // namespace wdedup
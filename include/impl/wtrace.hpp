@@ -0,0 +1,186 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wtrace.hpp
+ * @author Haoran Luo
+ * @brief wdedup Timeline Tracing
+ *
+ * This file defines the tracing of spans, like filling and pouring
+ * a segment, merging, fsync-ing the log, planning and scanning, so
+ * that the stalls and the overlapping of threads could be inspected
+ * on a timeline, exported in Chrome trace event format (which could
+ * be opened by chrome://tracing or Perfetto UI).
+ *
+ * Each thread records its spans into its own buffer, which is a list
+ * of fixed size chunks published by release stores, so that recording
+ * is lock-free and the buffers could be exported while recording. A
+ * disabled span costs a relaxed load only.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace wdedup {
+
+/// @brief A span recorded on the timeline.
+struct TraceEvent {
+	/// The name of the span, which must be a string literal.
+	const char* name;
+
+	/// The identifier of the span, like segment id or merge id.
+	uint64_t id;
+
+	/// The start and duration of the span, in unit of nanoseconds
+	/// since the tracing is enabled.
+	uint64_t start, duration;
+};
+
+/// @brief A chunk of spans recorded by a thread.
+struct TraceChunk {
+	/// Number of spans inside a chunk.
+	static constexpr size_t capacity = 1024;
+
+	/// The spans, where the first size spans are published.
+	TraceEvent events[capacity];
+	std::atomic<size_t> size;
+
+	/// The next chunk, published once current chunk is full.
+	std::atomic<wdedup::TraceChunk*> next;
+
+	TraceChunk() noexcept: size(0), next(nullptr) {}
+	~TraceChunk() noexcept { delete next.load(); }
+};
+
+/// @brief The spans recorded by a thread, written by the thread only.
+struct TraceBuffer {
+	/// The thread id of the recording thread.
+	long tid;
+
+	/// The first chunk and the chunk being written.
+	wdedup::TraceChunk head;
+	wdedup::TraceChunk* tail;
+
+	TraceBuffer() noexcept: tid(syscall(SYS_gettid)), head(), tail(&head) {}
+
+	/// Record a span, which is dropped if there's no memory.
+	void record(const wdedup::TraceEvent& event) noexcept {
+		size_t size = tail->size.load(std::memory_order_relaxed);
+		if(size == wdedup::TraceChunk::capacity) {
+			wdedup::TraceChunk* chunk = new (std::nothrow) wdedup::TraceChunk;
+			if(chunk == nullptr) return;
+			tail->next.store(chunk, std::memory_order_release);
+			tail = chunk; size = 0;
+		}
+		tail->events[size] = event;
+		tail->size.store(size + 1, std::memory_order_release);
+	}
+};
+
+/// @brief The process-wide registry of the buffers.
+struct TraceRegistry {
+	/// Whether tracing is enabled.
+	std::atomic<bool> enabled;
+
+	/// The time when tracing is enabled.
+	std::chrono::steady_clock::time_point epoch;
+
+	/// The buffers of threads ever recorded, which are registered 
+	/// once by each thread and never released.
+	std::mutex mutex;
+	std::vector<std::unique_ptr<wdedup::TraceBuffer>> buffers;
+
+	TraceRegistry() noexcept: enabled(false), 
+		epoch(std::chrono::steady_clock::now()) {}
+};
+
+/// Retrieve the process-wide registry.
+inline wdedup::TraceRegistry& traceRegistry() noexcept {
+	static wdedup::TraceRegistry registry;
+	return registry;
+}
+
+/// Retrieve the buffer of current thread, registering it on first use.
+inline wdedup::TraceBuffer* traceBuffer() noexcept {
+	static thread_local wdedup::TraceBuffer* buffer = nullptr;
+	if(buffer != nullptr) return buffer;
+	try {
+		wdedup::TraceRegistry& registry = traceRegistry();
+		std::unique_ptr<wdedup::TraceBuffer> created(new wdedup::TraceBuffer);
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.buffers.push_back(std::move(created));
+		buffer = registry.buffers.back().get();
+	} catch(...) {}
+	return buffer;
+}
+
+/// Retrieve the nanoseconds since tracing is enabled.
+inline uint64_t traceNow() noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - traceRegistry().epoch).count();
+}
+
+/// Whether tracing is enabled.
+inline bool traceEnabled() noexcept {
+	return traceRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+/// @brief Records a span from its construction to its destruction.
+class TraceSpan {
+	/// The span being recorded, name is nullptr if disabled.
+	wdedup::TraceEvent event;
+public:
+	/// Start the span, nothing is recorded if tracing is disabled.
+	TraceSpan(const char* name, uint64_t id = 0) noexcept {
+		event.name = traceEnabled()? name : nullptr;
+		if(event.name == nullptr) return;
+		event.id = id;
+		event.start = traceNow();
+	}
+
+	/// End the span, and record it into the buffer of current thread.
+	void finish() noexcept {
+		if(event.name == nullptr) return;
+		event.duration = traceNow() - event.start;
+		wdedup::TraceBuffer* buffer = traceBuffer();
+		if(buffer != nullptr) buffer->record(event);
+		event.name = nullptr;
+	}
+
+	/// End the span if it has not been finished.
+	~TraceSpan() noexcept { finish(); }
+};
+
+/// Enable tracing, spans started from now on will be recorded.
+void traceStart() noexcept;
+
+/// Write out the recorded spans in Chrome trace event format.
+void traceWrite(std::ostream&);
+
+} // namespace wdedup
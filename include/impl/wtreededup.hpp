@@ -37,6 +37,7 @@
  */
 #pragma once
 #include "wprofile.hpp"
+#include "wdedup.hpp"
 #include "impl/wwmman.hpp"
 #include "wbloom.hpp"
 #include <bsd/sys/tree.h>
@@ -47,14 +48,19 @@ struct TreeDedupItem final {
 	/// The Bloom-ed string key.
 	wdedup::Bloom bloom;
 
-	/// The first occurence of this item. Will be 0 if it is repeated,
-	/// otherwise will be occur + 1.
+	/// The first occurence of this item. Will be occur + 1 if it is 
+	/// not repeated, otherwise treeDedupRepeated will be set and the
+	/// other bits will be the number of occurences.
 	wdedup::fileoff_t occur;
 
 	/// The embedded tree node, comparator defined else where.
 	RB_ENTRY(TreeDedupItem) rbnode;
 };
 
+/// The flag of TreeDedupItem::occur indicating the item is repeated.
+static constexpr wdedup::fileoff_t treeDedupRepeated = 
+	(wdedup::fileoff_t)1 << (sizeof(wdedup::fileoff_t) * 8 - 1);
+
 /// Defines the root node of the tree dedup item. It will be embedded
 /// into the TreeDedup structure.
 RB_HEAD(TreeDedupRbtree, TreeDedupItem);
@@ -101,6 +107,16 @@ struct TreeDedup final {
 	/// once after the operation is done.
 	static size_t pour(TreeDedup, std::unique_ptr<wdedup::ProfileOutput>) 
 			throw (wdedup::Error);
+
+	/// Number of words inserted, and how many of them have been found
+	/// already inserted.
+	size_t inserted, repeated;
+
+	/// Number of items whose words spill into the string pool.
+	size_t longWords;
+
+	/// Retrieve the occupancy of the working memory.
+	wdedup::SegmentOccupancy occupancy() const noexcept;
 private:
 	/// The working memory manager used to allocate objects.
 	wdedup::MemoryManager<TreeDedupItem> wmman;
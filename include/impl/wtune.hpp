@@ -0,0 +1,96 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wtune.hpp
+ * @author Haoran Luo
+ * @brief wdedup Host Tuning Profile
+ *
+ * This file defines the tuning profile of the host, which is measured
+ * by the "wdedup tune" subcommand with short calibrations under a 
+ * scratch directory: the sequential read and write bandwidth with each
+ * buffer size, the latency of fsync and the insert rate of the engine.
+ *
+ * The buffer sizes of roles and the synchronization distance are chosen
+ * from the measurements, and they are loaded automatically by later 
+ * tasks (unless overriden by the --buffer-size and --sync-distance).
+ * The profile is a text file of "key value" lines, where keys unknown
+ * to the reader are ignored, so that more keys could be appended.
+ */
+#pragma once
+#include "wtypes.hpp"
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace wdedup {
+
+/// @brief The tuning profile of the host.
+struct TuningProfile {
+	/// The sequential read bandwidth of the best buffer size, in unit
+	/// of bytes per second, with the page cache dropped.
+	double readBandwidth = 0.0;
+
+	/// The median latency of synchronizing the log, in unit of seconds.
+	double fsyncSeconds = 0.0;
+
+	/// The bytes of words inserted into the engine per second.
+	double insertBandwidth = 0.0;
+
+	/// The buffer sizes of files by their roles.
+	std::map<std::string, size_t> bufferSizes;
+
+	/// Retrieve the synchronization distance, so that synchronizing
+	/// takes no more than 1% of profiling the original file, which is
+	/// bounded by reading and by inserting. The distance is within the 
+	/// specified range, and the maximum is returned if the profile has
+	/// not been measured.
+	size_t syncDistance(size_t minimum, size_t maximum) const noexcept;
+
+	/// Load the profile from the specified path. False will be returned
+	/// if the profile does not exist or cannot be read.
+	bool load(const std::string& path) noexcept;
+
+	/// Save the profile to the specified path, which is replaced 
+	/// atomically with a temporary file beside it.
+	void save(const std::string& path) const throw (wdedup::Error);
+};
+
+/// Retrieve the default path of the tuning profile, which is taken
+/// from $WDEDUP_TUNING, or "$HOME/.wdedup-tuning" otherwise.
+std::string tuningPath() noexcept;
+
+/**
+ * @brief Measures the tuning profile of the host.
+ *
+ * The calibrations write and read files of specified size under the
+ * scratch directory, which should be on the same disk as the working
+ * directories of later tasks. The files are removed afterwards, and
+ * each measurement is reported to the log as it is done.
+ *
+ * @throw wdedup::Error when the files under scratch directory cannot 
+ * be created, written or read.
+ */
+wdedup::TuningProfile wtune(const std::string& scratch, 
+	size_t size, std::ostream& log) throw (wdedup::Error);
+
+} // namespace wdedup
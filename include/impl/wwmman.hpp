@@ -112,6 +112,15 @@ template<typename itemType> struct MemoryManager {
 
 	// Return number of item allocated by manager.
 	size_t size() const noexcept { return arraysize; }
+
+	// Return bytes occupied at the array end.
+	size_t arrayBytes() const noexcept { return arraysize * sizeof(itemType); }
+
+	// Return bytes occupied at the pool end.
+	size_t poolBytes() const noexcept { return poolsize; }
+
+	// Return bytes of the working memory.
+	size_t capacity() const noexcept { return vmsize; }
 private:
 	/// The virtual memory used as working memory.
 	void* vmaddr;
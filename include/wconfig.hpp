@@ -40,11 +40,65 @@
 #include <memory>
 #include <tuple>
 #include <string>
+#include <vector>
 #include "wio.hpp"
 #include "wprofile.hpp"
 
 namespace wdedup {
 
+/// The thread pool shared by stages, see impl/wpool.hpp.
+class ThreadPool;
+
+/// The occupancy of working memory by a segment, see wdedup.hpp.
+struct SegmentOccupancy;
+
+/// The memory budget shared by stages, see impl/wbudget.hpp.
+class MemoryBudget;
+
+/// The statistics report of the task, see impl/wstats.hpp.
+class StatsReport;
+
+/// The progress of the task, see impl/wprogress.hpp.
+class ProgressReport;
+
+/**
+ * @brief Segment Cache Interface
+ *
+ * The segment cache stores profiles of contents that might be shared
+ * across tasks, such as overlapping snapshots, keyed by the digest of
+ * the content. The occurences inside a cached profile are relative to
+ * the start of the content, so that it could be reused wherever the 
+ * content is found in the original file.
+ */
+struct SegmentCache {
+	/// Virtual destructor for pure virtual interface.
+	virtual ~SegmentCache() noexcept {}
+
+	/// Open the cached profile of the specified key, nullptr will be
+	/// returned if there's no such profile in the cache. The occupancy
+	/// stored with the profile is retrieved, which is left 0 if it is
+	/// not stored.
+	virtual std::unique_ptr<wdedup::ProfileInput> openCached(
+			const std::string& key, wdedup::SegmentOccupancy& occupancy
+			) throw (wdedup::Error) = 0;
+
+	/// Create the cached profile of the specified key, storing the 
+	/// occupancy of the segment with it. The profile will be visible 
+	/// to other tasks only after it has been closed.
+	virtual std::unique_ptr<wdedup::ProfileOutput> createCached(
+			const std::string& key, const wdedup::SegmentOccupancy& 
+			occupancy) throw (wdedup::Error) = 0;
+
+	/// Number of contents whose profile has been found in the cache.
+	size_t hits = 0;
+
+	/// Number of contents whose profile has been missing in the cache.
+	size_t misses = 0;
+
+	/// Number of bytes of contents that are not profiled again.
+	size_t savedBytes = 0;
+};
+
 /**
  * @brief Task Configuration Interface
  *
@@ -83,6 +137,20 @@ struct Config {
 	virtual std::unique_ptr<wdedup::ProfileInput>
 			openInput(std::string path) throw (wdedup::Error) = 0;
 
+	/// Open a profile input under workdir, starting from the specified
+	/// block. Only ProfileBlock::items items belong to the block.
+	virtual std::unique_ptr<wdedup::ProfileInput>
+			openInput(std::string path, const wdedup::ProfileBlock&)
+			throw (wdedup::Error) = 0;
+
+	/// Retrieve the block summaries of a profile under workdir.
+	virtual std::vector<wdedup::ProfileBlock>
+			openIndex(std::string path) throw (wdedup::Error) = 0;
+
+	/// Open a profile under workdir for looking up words.
+	virtual std::unique_ptr<wdedup::ProfileLookup>
+			openLookup(std::string path) throw (wdedup::Error) = 0;
+
 	/// Open a profile input that filter out repeated profile item.
 	virtual std::unique_ptr<wdedup::ProfileInput>
 			openSingularInput(std::string path) throw (wdedup::Error) = 0;
@@ -90,8 +158,28 @@ struct Config {
 	/// Remove specified log file if it already exists.
 	virtual void remove(std::string path) throw (wdedup::Error) = 0;
 
-	/// Retrieve the working memory of the program.
-	virtual std::tuple<void*, size_t> workmem() const noexcept = 0;
+	/// Retrieve the memory budget carving the working memory of the
+	/// program into leases.
+	virtual wdedup::MemoryBudget& budget() noexcept = 0;
+
+	/// Retrieve the segment cache, nullptr will be returned if the
+	/// segment cache is disabled.
+	virtual wdedup::SegmentCache* cache() noexcept = 0;
+
+	/// Retrieve the thread pool that the stages submit tasks to.
+	virtual wdedup::ThreadPool& pool() noexcept = 0;
+
+	/// Retrieve whether wprof fills the next segment while pouring
+	/// the previous one, each with half of the budget.
+	virtual bool overlapPour() noexcept = 0;
+
+	/// Retrieve the statistics report that the stages place their 
+	/// measurements, nullptr will be returned if it is disabled.
+	virtual wdedup::StatsReport* stats() noexcept = 0;
+
+	/// Retrieve the progress of the task that the stages advance, 
+	/// which is exported only if it is requested.
+	virtual wdedup::ProgressReport& progress() noexcept = 0;
 };
 
 } // namespace wdedup
@@ -30,11 +30,53 @@
  */
 #pragma once
 #include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <ostream>
 #include "wtypes.hpp"
 #include "wconfig.hpp"
 
 namespace wdedup {
 
+/**
+ * @brief Defines the occupancy of working memory by a segment.
+ *
+ * The number of words fitting in the working memory determines the
+ * number of segments, and therefore the cost of merging. So how the
+ * working memory is occupied is recorded for each profiled segment,
+ * in order to size the working memory. The cached segments carry
+ * the occupancy of when they were profiled, and the fields are 0 
+ * for the segments whose occupancy is not known.
+ */
+struct SegmentOccupancy {
+	/// Number of words profiled into the segment.
+	uint64_t tokens = 0;
+
+	/// Number of words found already profiled into the segment.
+	uint64_t repeated = 0;
+
+	/// Number of distinct words, which are the items of the segment.
+	uint64_t items = 0;
+
+	/// Number of items whose words are too long to be embedded, and
+	/// spill into the string pool.
+	uint64_t longWords = 0;
+
+	/// Bytes occupied by the items and by the string pool.
+	uint64_t arrayBytes = 0, poolBytes = 0;
+
+	/// Bytes of the working memory that the segment is profiled in.
+	uint64_t capacity = 0;
+
+	/// Retrieve the fields in order of their serialization, so that
+	/// more fields could only be appended.
+	std::vector<uint64_t*> fields() noexcept {
+		return { &tokens, &repeated, &items, &longWords, 
+			&arrayBytes, &poolBytes, &capacity };
+	}
+};
+
 /**
  * @brief Defines a profile segment.
  *
@@ -53,6 +95,9 @@ struct ProfileSegment {
 
 	/// (Physical) size of current profile segment. 
 	size_t size;
+
+	/// The occupancy of working memory while profiling the segment.
+	wdedup::SegmentOccupancy occupancy;
 };
 
 /**
@@ -66,6 +111,8 @@ struct ProfileSegment {
  * @param[in] path the original file path.
  * @param[in] syncDistance the synchronization distance, set to
  * 0 means to disable such synchronization.
+ * @param[in] start the offset of original file to start profiling.
+ * @param[in] id the id of the first generated segment.
  * @return the file generated while profiling. All file MUST be
  * ordered by their order corresponding to original file, and 
  * none of them should overlaps.
@@ -74,7 +121,8 @@ struct ProfileSegment {
  */
 std::vector<wdedup::ProfileSegment>
 wprof(wdedup::Config& cfg, const std::string& path, 
-	size_t syncDistance = 0) throw (wdedup::Error);
+	size_t syncDistance = 0, fileoff_t start = 0, 
+	size_t id = 0) throw (wdedup::Error);
 
 /// @brief Defines a merge plan.
 struct MergePlan {
@@ -87,6 +135,10 @@ struct MergePlan {
 
 	/// Right segment ID of the merged segment.
 	size_t right;
+
+	/// The I/O cost of the merge estimated by the planner, in unit
+	/// of bytes. It will be 0 if the planner does not estimate.
+	size_t cost;
 };
 
 /**
@@ -114,6 +166,11 @@ struct MergeSegment {
  * The merge planner must ensure that it yields the identical result
  * when given same leaf segments information and merged segments
  * information.
+ *
+ * The wmerge stage pops all plans before the merged segments are
+ * pushed back, so that independent merges run on the thread pool.
+ * The plans must be popped in an order that each merge comes after
+ * the merges producing its inputs.
  */
 struct MergePlanner {
 	/// Virtual destructor for pure virtual class.
@@ -154,6 +211,75 @@ struct MergePlanner {
 size_t wmerge(wdedup::Config& cfg, wdedup::MergePlanner& planner, 
 		bool disableGC) throw (wdedup::Error);
 
+/**
+ * @brief Executes the grow stage on the original file.
+ *
+ * The original file is assumed to be append-only. When it has grown
+ * since it was profiled, only the appended content is profiled into
+ * new segments (a generation), which are then merged with the final
+ * profile of previous generation. So the profiling costs in proportion
+ * to the appended content, while the merging still reads and rewrites
+ * the whole previous final profile, as every final stage scans a 
+ * single profile. The merging is cheaper than profiling the whole file
+ * again as long as words repeat.
+ *
+ * When the appended content continues the last word of the profiled
+ * content, the generation is profiled from the start of that word,
+ * and its occurence is trimmed from a copy of the previous final
+ * profile. If it could not be trimmed, as the word would become 
+ * singular or its number of occurences is not recorded, the whole
+ * file is profiled again instead.
+ *
+ * Generations recorded in the log are always replayed, even if the
+ * growing is not enabled. A new generation could not be recorded
+ * once a logging final stage (like list-all) has been recorded, and
+ * an error is thrown if the original file has grown since then.
+ *
+ * @param[inout] cfg the configuration of current task.
+ * @param[in] path the original file path.
+ * @param[in] segments the segments of the first generation.
+ * @param[in] root the id of the final profile of first generation.
+ * @param[in] syncDistance the synchronization distance of wprof.
+ * @param[in] disableGC disable garbage collection of wmerge.
+ * @param[in] grow whether the appended content should be profiled.
+ * @return the id of the final profile of last generation.
+ * @throw wdedup::Error when the original file is missing, cannot
+ * create file under working directory, etc.
+ */
+size_t wgrow(wdedup::Config& cfg, const std::string& path,
+		const std::vector<wdedup::ProfileSegment>& segments, 
+		size_t root, size_t syncDistance, bool disableGC, 
+		bool grow) throw (wdedup::Error);
+
+/**
+ * @brief Executes the verify-first stage on the profile segments.
+ *
+ * The earliest singular words of the first segment are likely to be
+ * the result of find-first stage. They are taken as the candidates
+ * and checked against the other segments in order of their first
+ * occurence, looking up the sparse index and the bloom filter of the
+ * segments, and the first candidate absent from all other segments
+ * is the result, without merging any segment.
+ *
+ * There's no logging generated in this stage. The stage will not be
+ * executed once wmerge has begun, since the segments might have been
+ * garbage collected, and the caller should fall back to wmerge and 
+ * the find-first stage when there's no result.
+ * @throw wdedup::Error when the profile segment is missing, etc.
+ *
+ * @param[in] segments the segments generated by wprof.
+ * @param[in] candidates the number of candidates to verify.
+ * @param[out] result the first non-repeating word if found.
+ * @param[in] threads the number of threads for scanning.
+ * @return whether the verification is conclusive. If true is
+ * returned, result will be the single string that appears first,
+ * or empty string if all words are duplicated.
+ */
+bool wverify(wdedup::Config& cfg, 
+		const std::vector<wdedup::ProfileSegment>& segments,
+		size_t candidates, std::string& result,
+		size_t threads = 1) throw (wdedup::Error);
+
 /**
  * @brief Executes the find-first stage on the original file.
  *
@@ -161,11 +287,114 @@ size_t wmerge(wdedup::Config& cfg, wdedup::MergePlanner& planner,
  * merged log will be repeated if executed on a working directory
  * containing a finished task. (It also makes it possible to
  * execute different task based on the final merged result).
+ *
+ * The block summaries of the final profile are consulted, so that
+ * only blocks that might contain the result will be scanned. The
+ * blocks are scanned by multiple threads, each of them keeping its
+ * own minimum, and the minimums are reduced after scanning.
  * @throw wdedup::Error when the final profile is missing, etc.
  *
+ * @param[in] threads the number of threads for scanning.
  * @return empty string if all words are duplicated, or the single
  * string that appers first.
  */
-std::string wfindfirst(wdedup::Config& cfg, size_t root) 
+std::string wfindfirst(wdedup::Config& cfg, size_t root,
+		size_t threads = 1) throw (wdedup::Error);
+
+/**
+ * @brief Executes the find-topN stage on the original file.
+ *
+ * Just like the find-first stage, there's no logging generated in 
+ * this stage. The blocks of the final profile are scanned in a 
+ * single pass by multiple threads, each of them keeping a bounded
+ * heap of the earliest singular words, and the heaps are merged
+ * after scanning.
+ * @throw wdedup::Error when the final profile is missing, etc.
+ *
+ * @param[in] n the number of words to find.
+ * @param[in] threads the number of threads for scanning.
+ * @return up to n singular words ordered by their first occurence.
+ * Less than n words will be returned if there're not enough of them.
+ */
+std::vector<std::string> wfindtopn(wdedup::Config& cfg, size_t root,
+		size_t n, size_t threads = 1) throw (wdedup::Error);
+
+/**
+ * @brief Executes the find-topK stage on the original file.
+ *
+ * Just like the find-topN stage, there's no logging generated in 
+ * this stage. The blocks of the final profile are visited in order
+ * of their maximum number of occurences by multiple threads, each of
+ * them keeping a bounded heap of the most frequent words, and blocks
+ * that could not contain such words are skipped.
+ * @throw wdedup::Error when the final profile is missing, or the 
+ * number of occurences is not recorded in the final profile.
+ *
+ * @param[in] k the number of words to find.
+ * @param[in] threads the number of threads for scanning.
+ * @return up to k words with their number of occurences, ordered by
+ * descending number of occurences and then by the words.
+ */
+std::vector<std::pair<std::string, size_t>> wfindtopk(
+		wdedup::Config& cfg, size_t root, size_t k, 
+		size_t threads = 1) throw (wdedup::Error);
+
+/**
+ * @brief Executes the count stage on the original file.
+ *
+ * Just like the find-first stage, there's no logging generated in 
+ * this stage. Every block of the final profile is scanned by multiple
+ * threads, each of them counting its own words, and the counters are
+ * summed up after scanning.
+ * @throw wdedup::Error when the final profile is missing, etc.
+ *
+ * @param[in] threads the number of threads for scanning.
+ * @return the number of distinct words and the number of singular
+ * (non-repeating) words.
+ */
+std::pair<size_t, size_t> wcount(wdedup::Config& cfg, size_t root,
+		size_t threads = 1) throw (wdedup::Error);
+
+/**
+ * @brief Executes the list-all stage on the original file.
+ *
+ * The singular words of the final profile are externally sorted by 
+ * their first occurence: sorted runs are generated in the working
+ * memory by multiple threads, and then merged as is planned by the 
+ * merge planner. The sorted runs and merged runs are logged so that
+ * the sorting could be resumed, and the sorted profile is kept so
+ * that listing again will not sort again.
+ *
+ * @param[inout] cfg the configuration of current task.
+ * @param[in] root the id of the final merged profile.
+ * @param[in] out the stream to print out the words, one per line.
+ * @param[in] threads the number of threads for generating runs.
+ * @param[in] disableGC disable garbage collection of merged runs.
+ * @throw wdedup::Error when the final profile is missing, cannot
+ * create file under working directory, etc.
+ */
+void wlist(wdedup::Config& cfg, size_t root, std::ostream& out,
+		size_t threads = 1, bool disableGC = false) 
 		throw (wdedup::Error);
+
+/**
+ * @brief Answers word lookups on the final profile of a finished task.
+ *
+ * The words are read in batches, each of them is looked up through 
+ * the sparse index and the bloom filters of the final profile by 
+ * multiple threads, and the results are printed in input order, one
+ * per line, as "word\tunique\toffset", "word\trepeated" or 
+ * "word\tabsent", where the number of occurences will be appended
+ * to repeated word if it is recorded. There's no logging generated
+ * in this stage.
+ *
+ * @param[inout] cfg the configuration of current task.
+ * @param[in] root the id of the final merged profile.
+ * @param[in] in the stream to read words from, one per line.
+ * @param[in] out the stream to print out the results.
+ * @param[in] threads the number of threads for looking up.
+ * @throw wdedup::Error when the final profile is missing, etc.
+ */
+void wquery(wdedup::Config& cfg, size_t root, std::istream& in,
+		std::ostream& out, size_t threads = 1) throw (wdedup::Error);
 } // namespace wdedup
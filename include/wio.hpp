@@ -39,10 +39,12 @@
  */
 #pragma once
 #include <cstddef>
+#include <map>
 #include <memory>
 #include <string>
 #include <cstring>
 #include <vector>
+#include <cstdint>
 #include "wtypes.hpp"
 
 namespace wdedup {
@@ -68,12 +70,37 @@ struct FileMode {
 	///  write to the end of the file).
 	fileoff_t seekset;
 
+	/// The buffer size of the file in unit of bytes, which overrides
+	/// the buffer size of its role. When it is 0, the buffer size is
+	/// looked up in FileMode::defaultBuffers() by the role when the 
+	/// file is opened, and files of roles not found will be buffered
+	/// by the default size (see impl/wiobase.hpp).
+	/// (wdedup::AppendFile of log file will ignore because it 
+	///  buffers all content between wdedup::sync).
+	size_t bufsize;
+
 	/// Default constructor of the file mode.
-	FileMode() noexcept: log(false), seekset(0) {}
+	FileMode() noexcept: log(false), seekset(0), bufsize(0) {}
 
 	/// Copy constructor of the file mode.
 	FileMode(const FileMode& c) noexcept: log(c.log), 
-		seekset(c.seekset) {}
+		seekset(c.seekset), bufsize(c.bufsize) {}
+
+	/// Retrieve the buffer size of files of the specified role, 0
+	/// will be returned if the default size should be used.
+	size_t bufferSize(const std::string& role) const noexcept {
+		if(bufsize > 0) return bufsize;
+		const std::map<std::string, size_t>& buffers = defaultBuffers();
+		auto found = buffers.find(role);
+		return found == buffers.end()? 0 : found->second;
+	}
+
+	/// Retrieve the process-wide buffer sizes by roles, which should
+	/// be configured before any file is opened.
+	static std::map<std::string, size_t>& defaultBuffers() noexcept {
+		static std::map<std::string, size_t> buffers;
+		return buffers;
+	}
 };
 
 /**
@@ -206,6 +233,7 @@ inline SequentialFile& operator>>(
 	// Read until '\0' is expected.
 	while(true) {
 		size_t bldsize = strbld.size();
+		strbld.resize(bldsize + bufsiz);
 		memcpy(&strbld[bldsize], bufptr, bufsiz);
 		seq.bufferskip(bufsiz);
 		seq.bufferptr(bufptr, bufsiz);
@@ -223,6 +251,32 @@ inline SequentialFile& operator>>(
 	}
 }
 
+/// Wrapper for serializing unsigned integer in variable length, 
+/// where each byte carries 7 bits and the highest bit indicates 
+/// whether there're more bytes, so that smaller values take less
+/// bytes in the file.
+struct Varint {
+	/// The referenced value to read or write.
+	uint64_t& value;
+};
+
+/// Wrap the referenced value for serializing in variable length.
+inline Varint varint(uint64_t& value) noexcept { return Varint{value}; }
+
+/// Read unsigned integer of variable length from the sequential file.
+inline SequentialFile& operator>>(
+	SequentialFile& seq, const Varint& v
+) throw (wdedup::Error) {
+	uint64_t value = 0; unsigned char c;
+	for(size_t shift = 0; ; shift += 7) {
+		seq.read((char*)&c, 1);
+		value |= (uint64_t)(c & 0x7f) << shift;
+		if(!(c & 0x80)) break;
+	}
+	v.value = value;
+	return seq;
+}
+
 /**
  * @brief Defines the append-only output file.
  *
@@ -313,6 +367,22 @@ inline AppendFile& operator<<(
 	return app;
 }
 
+/// Write unsigned integer of variable length to the append file.
+inline AppendFile& operator<<(
+	AppendFile& app, const Varint& v
+) throw (wdedup::Error) {
+	char buf[10]; size_t size = 0;
+	uint64_t value = v.value;
+	do {
+		buf[size] = (char)(value & 0x7f);
+		value >>= 7;
+		if(value != 0) buf[size] |= (char)0x80;
+		++ size;
+	} while(value != 0);
+	app.write(buf, size);
+	return app;
+}
+
 /// Specific object that flushes the append file, just like std::endl.
 struct AppendSynchronizer {};
 static constexpr AppendSynchronizer sync;
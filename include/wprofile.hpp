@@ -56,18 +56,59 @@ struct ProfileItem {
 	/// scanning algorithms.
 	fileoff_t occur;
 
-	/// Construct a repeated item.
+	/// The number of occurences of the word. It is always 1 for the 
+	/// single occurence item, and will be 0 for the repeated item if
+	/// the number is not recorded.
+	size_t count;
+
+	/// Construct a repeated item, whose number of occurences is not 
+	/// recorded until it is assigned.
 	ProfileItem(std::string word) noexcept: 
-		word(std::move(word)), repeated(true), occur(0) {}
+		word(std::move(word)), repeated(true), occur(0), count(0) {}
 
 	/// Construct a single occurence item.
 	ProfileItem(std::string word, fileoff_t occur) noexcept:
-		word(std::move(word)), repeated(false), occur(occur) {}
+		word(std::move(word)), repeated(false), occur(occur), count(1) {}
 
 	/// Move constructor of a profile item.
 	ProfileItem(ProfileItem&& item) noexcept:
-		word(std::move(item.word)), 
-		repeated(item.repeated), occur(item.occur) {}
+		word(std::move(item.word)), repeated(item.repeated), 
+		occur(item.occur), count(item.count) {}
+};
+
+/**
+ * @brief Defines the summary of a block inside a profile.
+ *
+ * The profile is divided into consecutive blocks while it is being
+ * written, and a summary (zone map) is recorded for each block, so
+ * that scanning algorithms could skip blocks without reading them.
+ */
+struct ProfileBlock {
+	/// The minimum occurence of a block without singular item.
+	static constexpr fileoff_t none = (fileoff_t)(-1);
+
+	/// Offset of the first item of the block in the profile.
+	fileoff_t offset;
+
+	/// (Physical) size of the block in the profile.
+	size_t size;
+
+	/// Number of profile items inside the block.
+	size_t items;
+
+	/// The minimum occurence among singular items inside the
+	/// block. It will be ProfileBlock::none if all items inside
+	/// the block are repeated.
+	fileoff_t minOccur;
+
+	/// The maximum number of occurences among items inside the
+	/// block. It will be 0 if the number of occurences of any 
+	/// repeated item inside the block is not recorded.
+	size_t maxCount;
+
+	/// The first word of the block. As the words are sorted, the
+	/// first words of blocks form a sparse index of the profile.
+	std::string first;
 };
 
 /// @brief Defines the virtual read interface of profile.
@@ -89,6 +130,18 @@ struct ProfileInput {
 	virtual ProfileItem pop() throw (wdedup::Error) = 0;
 };
 
+/// @brief Defines the virtual point lookup interface of profile.
+struct ProfileLookup {
+	/// Virtual destructor for pure virtual classes.
+	virtual ~ProfileLookup() noexcept {};
+
+	/// Look up the word in the profile. If the word is found, the
+	/// profile item will be copied out and true will be returned.
+	/// The lookup might be invoked concurrently.
+	virtual bool find(const std::string& word, 
+		ProfileItem& item) const throw (wdedup::Error) = 0;
+};
+
 /// @brief Defines the virtual write interface of profile.
 struct ProfileOutput {
 	/// Virtual destructor for pure virtual classes.
@@ -36,6 +36,11 @@ namespace wdedup {
 /// Forwarded definition of file offset type.
 using fileoff_t = size_t;
 
+/// Helper for judging whether a character separates words.
+inline bool isWhitespace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
 /**
  * @brief thrown information about unrecoverable errors.
  *
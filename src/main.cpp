@@ -31,11 +31,24 @@
 #include "wdedup.hpp"
 #include "impl/wpflsimple.hpp"
 #include "impl/wpflfilter.hpp"
+#include "impl/wcache.hpp"
 //#include "impl/wmpsimple.hpp"
 #include "impl/wmpdp.hpp"
 #include "impl/wcli.hpp"
+#include "impl/wfind.hpp"
+#include "impl/wpool.hpp"
+#include "impl/wbudget.hpp"
+#include "impl/wiobase.hpp"
+#include "impl/wpressure.hpp"
+#include "impl/wstats.hpp"
+#include "impl/wprogress.hpp"
+#include "impl/wtrace.hpp"
+#include "impl/wtune.hpp"
 #include "wtypes.hpp"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -50,13 +63,48 @@ int main(int argc, char** argv) {
 	if(retcode != 0) return retcode;
 	if(!options.run) return 0;
 
+	// Measure and write out the tuning profile of the host.
+	if(options.tune) try {
+		wdedup::TuningProfile tuning = wdedup::wtune(
+			options.workdir, options.tuneSize, std::cerr);
+		tuning.save(options.tuning);
+		std::cerr << "Tuning profile is written to " 
+			<< options.tuning << "." << std::endl;
+		return 0;
+	} catch(wdedup::Error err) {
+		std::cerr << "Error: " << err.path;
+		if(err.role != "") std::cerr << " (" << err.role << "): ";
+		std::cerr << strerror(err.eno) << std::endl;
+		return -err.eno;
+	}
+
 	// Forward some command line arguments.
 	static const std::string& fileInput = options.origfile;
 	static const std::string& workdir = options.workdir;
 	static std::string logPath = workdir + "/log";
+	static const bool readonly = options.query;
+	static const bool counting = options.countWords;
+	static const bool overlapping = options.overlapPour;
 
-	// Allocate the memory space for executing wprof.
-	size_t userpageSize = options.workmem;
+	// Configure the buffer sizes before any file is opened, which are
+	// taken from the tuning profile unless specified explicitly.
+	wdedup::TuningProfile tuning;
+	if(options.tuning != "") tuning.load(options.tuning);
+	for(const auto& bufferSize : options.bufferSizes)
+		tuning.bufferSizes[bufferSize.first] = bufferSize.second;
+	wdedup::FileMode::defaultBuffers() = tuning.bufferSizes;
+	if(options.syncTuned) options.syncDistance = tuning.syncDistance(
+		wdedup::strsize(wdedup::minSyncDistance), options.syncDistance);
+
+	// Allocate the memory space for executing wprof. The file buffers
+	// are not leased from the budget, so their share is reserved off
+	// the top: the original file, and the two inputs and the output 
+	// (with its index and filter) of a merge on each thread.
+	size_t buffer = wdedup::bufsiz;
+	for(const auto& bufferSize : tuning.bufferSizes)
+		buffer = std::max(buffer, bufferSize.second);
+	size_t userpageSize = options.workmem - wdedup::ioShare(
+		options.workmem, 1 + 5 * options.threads, buffer);
 	std::shared_ptr<void> userpage([=]() -> void* {
 		void* userpage = mmap(NULL, userpageSize, PROT_READ | PROT_WRITE,
 			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -72,7 +120,17 @@ int main(int argc, char** argv) {
 			return userpage.get();
 		}(), [=](void* p) { munlock(p, userpageSize); });
 	}
-	static std::tuple<void*, size_t> wm(userpage.get(), userpageSize);
+	static wdedup::MemoryBudget memoryBudget(userpage.get(), userpageSize);
+
+	// Resize the working memory under memory pressure if specified.
+	std::unique_ptr<wdedup::MemoryGovernorCgroup> governor;
+	if(options.memoryPressure) {
+		governor.reset(new wdedup::MemoryGovernorCgroup(
+			userpageSize / 16, &std::cerr));
+		if(governor->available()) memoryBudget.govern(governor.get());
+		else std::cerr << "Warning: cgroup v2 memory controller is not "
+			"available, memory pressure is ignored." << std::endl;
+	}
 
 	// Arguments are parsed, now attempt to initialize and run stages.
 	try {
@@ -129,6 +187,8 @@ int main(int argc, char** argv) {
 			// Mark the recovery as done and switch the pilog with polog.
 			virtual void recoveryDone() throw (wdedup::Error) {
 				if(!(pilog != nullptr && polog == nullptr)) return;
+				// The task must have finished when read only.
+				if(readonly) throw wdedup::Error(EINPROGRESS, logPath, "log");
 				pilog = std::unique_ptr<wdedup::SequentialFile>();
 				openLogOutput();
 			}
@@ -138,7 +198,7 @@ int main(int argc, char** argv) {
 				openOutput(std::string path) throw (wdedup::Error) {
 				return std::unique_ptr<wdedup::ProfileOutput>(
 					new wdedup::ProfileOutputSimple(
-						workdir + "/" + path, profileMode));
+						workdir + "/" + path, profileMode, counting));
 			}
 
 			// Profile input creation function.
@@ -149,6 +209,32 @@ int main(int argc, char** argv) {
 						workdir + "/" + path, profileMode));
 			}
 
+			// Profile block input creation function.
+			virtual std::unique_ptr<wdedup::ProfileInput>
+				openInput(std::string path, const wdedup::ProfileBlock& block)
+				throw (wdedup::Error) {
+				wdedup::FileMode blockMode(profileMode);
+				blockMode.seekset = block.offset;
+				return std::unique_ptr<wdedup::ProfileInput>(
+					new wdedup::ProfileInputSimple(
+						workdir + "/" + path, blockMode));
+			}
+
+			// Profile index retrieval function.
+			virtual std::vector<wdedup::ProfileBlock>
+				openIndex(std::string path) throw (wdedup::Error) {
+				return wdedup::profileIndexSimple(
+					workdir + "/" + path, profileMode);
+			}
+
+			// Profile lookup creation function.
+			virtual std::unique_ptr<wdedup::ProfileLookup>
+				openLookup(std::string path) throw (wdedup::Error) {
+				return std::unique_ptr<wdedup::ProfileLookup>(
+					new wdedup::ProfileLookupSimple(
+						workdir + "/" + path, profileMode));
+			}
+
 			// Profile singular input creation function.
 			virtual std::unique_ptr<wdedup::ProfileInput>
 				openSingularInput(std::string path) throw (wdedup::Error) {
@@ -158,20 +244,95 @@ int main(int argc, char** argv) {
 
 			// Remove existing file if it already exists.
 			virtual void remove(std::string path) throw (wdedup::Error) {
-				::remove((workdir + "/" + path).c_str());
+				wdedup::profileRemoveSimple(workdir + "/" + path);
 			}
 
-			// Return the working memory for each stage.
-			virtual std::tuple<void*, size_t> workmem() const noexcept {
-				return wm;
+			// Return the memory budget for each stage.
+			virtual wdedup::MemoryBudget& budget() noexcept {
+				return memoryBudget;
+			}
+
+			// Unique pointer managing the segment cache if enabled.
+			std::unique_ptr<wdedup::SegmentCache> pcache;
+
+			// Return the segment cache for wprof.
+			virtual wdedup::SegmentCache* cache() noexcept {
+				return pcache.get();
+			}
+
+			// Unique pointer managing the thread pool.
+			std::unique_ptr<wdedup::ThreadPool> ppool;
+
+			// Return the thread pool for each stage.
+			virtual wdedup::ThreadPool& pool() noexcept {
+				assert(ppool != nullptr);
+				return *ppool;
+			}
+
+			// Return whether the segments are poured while filling.
+			virtual bool overlapPour() noexcept {
+				return overlapping;
+			}
+
+			// Unique pointer managing the statistics report if enabled.
+			std::unique_ptr<wdedup::StatsReport> pstats;
+
+			// Return the statistics report for each stage.
+			virtual wdedup::StatsReport* stats() noexcept {
+				return pstats.get();
+			}
+
+			// The progress of the task.
+			wdedup::ProgressReport progressReport;
+
+			// Return the progress for each stage.
+			virtual wdedup::ProgressReport& progress() noexcept {
+				return progressReport;
 			}
 		} config;
 
+		// Write out the statistics report once all stages are left.
+		if(options.stats == "json") 
+			config.pstats.reset(new wdedup::StatsReport);
+		struct StatsWriter {
+			wdedup::StatsReport* report;
+			~StatsWriter() noexcept { 
+				try { if(report != nullptr) report->write(std::cerr); } 
+				catch(...) {}
+			}
+		} statsWriter { config.stats() };
+
+		// Write out the timeline once all stages are left.
+		if(options.trace != "") wdedup::traceStart();
+		struct TraceWriter {
+			std::string path;
+			~TraceWriter() noexcept {
+				if(path == "") return;
+				try {
+					std::ofstream out(path);
+					wdedup::traceWrite(out);
+					if(!out) std::cerr << "Warning: trace could not be "
+						"written to " << path << "." << std::endl;
+				} catch(...) {}
+			}
+		} traceWriter { options.trace };
+
+		// Export the progress periodically if requested.
+		if(options.progress != "") config.progressReport.start(
+			options.progress, wdedup::progressInterval);
+
+		// Create the thread pool shared by the stages.
+		config.ppool.reset(new wdedup::ThreadPool(
+			options.threads, options.affinity));
+
+		// Sample the hardware counters of the threads in the report.
+		if(config.pstats != nullptr) config.pstats->hardware();
+
 		// Check whether the working directory exists.
 		struct stat stwdir; if(stat(workdir.c_str(), &stwdir) < 0) {
 			bool shouldThrow = true;
 			// Attempt to create the directory if it does not exists.
-			if(errno == ENOENT) 
+			if(errno == ENOENT && !readonly) 
 				if(mkdir(workdir.c_str(), S_IRWXU) == 0) {
 					shouldThrow = false;
 					config.openLogOutput();
@@ -183,7 +344,9 @@ int main(int argc, char** argv) {
 
 			// Check whether the log file exists. And perform reading/writing.
 			struct stat stlog; if(stat(logPath.c_str(), &stlog) < 0) {
-				if(errno == ENOENT) config.openLogOutput();
+				if(errno == ENOENT && !readonly) config.openLogOutput();
+				else if(errno == ENOENT) 
+					throw wdedup::Error(ENOENT, logPath, "log");
 				else config.logCorrupt();
 			} else {
 				if(!S_ISREG(stlog.st_mode)) config.logCorrupt();
@@ -193,33 +356,177 @@ int main(int argc, char** argv) {
 
 		// Checking or writing out metadata. Different version of wdedup cannot operate
 		// on the same workding directory.
-		static const std::string version = "20190612.0001";	// Version identifier.
+		static const std::string version = "20190612.0008";	// Version identifier.
 		if(!config.hasRecoveryDone()) {
 			// Verify metadata information, to avoid disconsistency.
 			std::string expectedVersion; config.ilog() >> expectedVersion;
 			if(expectedVersion != version) config.logCorrupt();
+
+			// The profiles record the number of occurences only if they 
+			// are generated with it, so the flag must not be changed 
+			// unless nothing will be generated.
+			char expectedCounting; config.ilog() >> expectedCounting;
+			if(expectedCounting != (char)counting && !readonly)
+				throw wdedup::Error(EINVAL, workdir, "count-words");
 		} else {
 			config.recoveryDone();
 
 			// Write out metadata for ensuring consistent recovery operations.
-			config.olog() << version << wdedup::sync;
+			config.olog() << version << (char)counting << wdedup::sync;
 		}
 
+		// Look up words on the final profile of the finished task, whose
+		// id is recovered from the log without performing any stage.
+		if(options.query) {
+			auto profiles = wprof(config, fileInput, options.syncDistance);
+			wdedup::MergePlannerDP planner(config, profiles);
+			size_t root = wmerge(config, planner, true);
+			root = wgrow(config, fileInput, profiles, root, 
+				options.syncDistance, true, false);
+			if(options.words.size() == 0)
+				wquery(config, root, std::cin, std::cout, options.threads);
+			else {
+				std::stringstream words;
+				for(size_t i = 0; i < options.words.size(); ++ i)
+					words << options.words[i] << '\n';
+				wquery(config, root, words, std::cout, options.threads);
+			}
+			return 0;
+		}
+
+		// Open the segment cache shared by tasks if specified.
+		if(options.cacheDir != "") config.pcache.reset(
+			new wdedup::SegmentCacheSimple(options.cacheDir, 
+				profileMode, counting));
+
 		// Commence the processing of wprof.
-		auto profiles = wprof(config, fileInput, options.syncDistance);
+		std::vector<wdedup::ProfileSegment> profiles; {
+			wdedup::StatsReport::Scope scope(config.stats(), "wprof");
+			config.progress().stage("wprof");
+			profiles = wprof(config, fileInput, options.syncDistance);
+		}
+		if(config.pcache != nullptr && (config.pcache->hits > 0 || 
+			config.pcache->misses > 0)) std::cerr << "Segment cache: " 
+			<< config.pcache->hits << " hits, " << config.pcache->misses 
+			<< " misses, " << config.pcache->savedBytes 
+			<< " bytes saved." << std::endl;
 		if(options.profileOnly) return 0;
 
+		// Verify the earliest candidates before merging when find-first.
+		if(options.verifyFirst > 0 && !options.listAll && options.topN == 1 &&
+			options.topK == 0 && !options.mergeOnly && !options.incremental) {
+			std::string result; bool verified; {
+				wdedup::StatsReport::Scope scope(config.stats(), "wverify");
+				config.progress().stage("wverify");
+				verified = wverify(config, profiles, 
+					options.verifyFirst, result, options.threads);
+			}
+			if(verified) {
+				if(result != "") std::cout << result << std::endl;
+				return 0;
+			}
+		}
+
 		// Generate the merge planner.
 		//wdedup::MergePlannerSimple planner(config, std::move(profiles));
-		wdedup::MergePlannerDP planner(config, std::move(profiles));
+		wdedup::MergePlannerDP planner(config, profiles);
+		config.progress().plan(planner.schedule());
 
 		// Merge the result generated by wprof.
-		size_t root = wmerge(config, planner, options.disableGC);
+		size_t root; {
+			wdedup::StatsReport::Scope scope(config.stats(), "wmerge");
+			config.progress().stage("wmerge");
+			root = wmerge(config, planner, options.disableGC);
+		}
+
+		// Profile and merge the content appended to the original file.
+		{
+			wdedup::StatsReport::Scope scope(config.stats(), "wgrow");
+			config.progress().stage("wgrow");
+			root = wgrow(config, fileInput, profiles, root, 
+				options.syncDistance, options.disableGC, options.incremental);
+		}
 		if(options.mergeOnly) return 0;
 
-		// Find the root entry and print it out.
-		std::string result = wfindfirst(config, root);
-		if(result != "") std::cout << result << std::endl;
+		// Measure the final stage until the results are printed.
+		wdedup::StatsReport::Scope scope(config.stats(), 
+			options.listAll? "wlist" : "wfind");
+		config.progress().stage(options.listAll? "wlist" : "wfind");
+
+		// List all non-repeating entries and print them out.
+		if(options.listAll) {
+			wlist(config, root, std::cout, 
+				options.threads, options.disableGC);
+			return 0;
+		}
+
+		// Answer a single query by its own stage, or register the 
+		// requested queries on a single scan plan, where the earliest 
+		// entries are found unless other queries are requested.
+		bool findEarliest = options.topN > 1 || 
+			(options.topK == 0 && !options.countUnique);
+		size_t queries = (findEarliest? 1 : 0) + 
+			(options.topK > 0? 1 : 0) + (options.countUnique? 1 : 0);
+		std::string first;
+		std::vector<std::string> earliest;
+		std::vector<std::pair<std::string, size_t>> frequent;
+		std::pair<size_t, size_t> counted;
+		if(queries == 1) {
+			if(options.topN > 1) earliest = wdedup::wfindtopn(
+				config, root, options.topN, options.threads);
+			else if(findEarliest) first = 
+				wdedup::wfindfirst(config, root, options.threads);
+			else if(options.topK > 0) frequent = wdedup::wfindtopk(
+				config, root, options.topK, options.threads);
+			else counted = wdedup::wcount(config, root, options.threads);
+		} else {
+			std::string path = std::to_string(root);
+			std::vector<wdedup::ProfileBlock> blocks = 
+				config.openIndex(path);
+			wdedup::ScanPlan plan(options.threads);
+			wdedup::FindFirstConsumer findFirst(options.threads);
+			wdedup::FindTopNConsumer findTopN(options.threads, options.topN);
+			wdedup::FindTopKConsumer findTopK(options.threads, options.topK);
+			wdedup::CountConsumer count(options.threads);
+			if(findEarliest) {
+				if(options.topN > 1) plan.add(findTopN);
+				else plan.add(findFirst);
+			}
+			if(options.topK > 0) plan.add(findTopK);
+			if(options.countUnique) plan.add(count);
+
+			// Blocks are visited in order of their minimum occurence, 
+			// unless only the most frequent entries are requested.
+			plan.scan(config, path, blocks, 
+				(findEarliest || options.countUnique)? 
+				wdedup::occurOrder(blocks) : wdedup::countOrder(blocks));
+
+			// The most frequent entries are reduced first as their 
+			// counts might be missing.
+			if(options.topK > 0) frequent = findTopK.result(path);
+			if(options.topN > 1) earliest = findTopN.result();
+			else if(findEarliest) first = findFirst.result();
+			if(options.countUnique) counted = count.result();
+		}
+
+		// Print out the results of the queries.
+		if(findEarliest) {
+			if(queries > 1) std::cout << "# top-n" << std::endl;
+			for(size_t i = 0; i < earliest.size(); ++ i)
+				std::cout << earliest[i] << std::endl;
+			if(first != "") std::cout << first << std::endl;
+		}
+		if(options.topK > 0) {
+			if(queries > 1) std::cout << "# top-k" << std::endl;
+			for(size_t i = 0; i < frequent.size(); ++ i)
+				std::cout << frequent[i].first << '\t' 
+					<< frequent[i].second << std::endl;
+		}
+		if(options.countUnique) {
+			if(queries > 1) std::cout << "# count" << std::endl;
+			std::cout << "distinct\t" << counted.first << std::endl;
+			std::cout << "unique\t" << counted.second << std::endl;
+		}
 	} catch(wdedup::Error err) {
 		// Report the error to the users and exit with status code.
 		std::cerr << "Error: " << err.path;
@@ -0,0 +1,169 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wbudget.cpp
+ * @author Haoran Luo
+ * @brief wdedup Memory Budget Manager Implementation
+ *
+ * This file implements the memory budget manager, see the header 
+ * file for more definition details.
+ */
+#include "impl/wbudget.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace wdedup {
+
+MemoryLease& MemoryLease::operator=(MemoryLease&& l) noexcept {
+	if(this == &l) return *this;
+	if(budget != nullptr) budget->release(region, length);
+	budget = l.budget; region = l.region; length = l.length;
+	l.budget = nullptr; l.region = nullptr; l.length = 0;
+	return *this;
+}
+
+MemoryLease::~MemoryLease() noexcept {
+	if(budget != nullptr) budget->release(region, length);
+}
+
+MemoryBudget::MemoryBudget(void* arena, size_t capacity) noexcept:
+	arena((char*)arena), total(capacity / alignment * alignment), 
+	limit(total), governor(nullptr), regions(), leased(0), peak(0) {
+	if(total > 0) regions[0] = total;
+}
+
+size_t MemoryBudget::size() noexcept {
+	std::lock_guard<std::mutex> lock(mutex);
+	return limit;
+}
+
+size_t MemoryBudget::resize(size_t size) noexcept {
+	size = size / alignment * alignment;
+	if(size < alignment) size = alignment;
+	if(size > total) size = total;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(size < limit) {
+			// Return the pages of free regions beyond the budget.
+			size_t page = sysconf(_SC_PAGESIZE);
+			for(auto i = regions.begin(); i != regions.end(); ++ i) {
+				size_t begin = std::max(i->first, size);
+				size_t end = i->first + i->second;
+				begin = (begin + page - 1) / page * page;
+				end = end / page * page;
+				if(begin < end) madvise(arena + begin, 
+					end - begin, MADV_DONTNEED);
+			}
+		}
+		limit = size;
+	}
+	returned.notify_all();
+	return size;
+}
+
+void MemoryBudget::adapt() noexcept {
+	if(governor == nullptr) return;
+	size_t current = size();
+	size_t advised = governor->advise(current, total);
+	if(advised != current) resize(advised);
+}
+
+size_t MemoryBudget::peakLeased() noexcept {
+	std::lock_guard<std::mutex> lock(mutex);
+	return peak;
+}
+
+char* MemoryBudget::place(size_t size) noexcept {
+	// Place the region at the first free region large enough.
+	for(auto i = regions.begin(); i != regions.end(); ++ i) {
+		if(i->second < size || i->first + size > limit) continue;
+		size_t offset = i->first, remaining = i->second - size;
+		regions.erase(i);
+		if(remaining > 0) regions[offset + size] = remaining;
+		leased += size;
+		if(leased > peak) peak = leased;
+		return arena + offset;
+	}
+	return nullptr;
+}
+
+void MemoryBudget::release(char* region, size_t size) noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t offset = region - arena;
+		leased -= size;
+
+		// Coalesce with the adjacent free regions.
+		auto next = regions.lower_bound(offset);
+		if(next != regions.end() && next->first == offset + size) {
+			size += next->second;
+			next = regions.erase(next);
+		}
+		if(next != regions.begin()) {
+			auto prev = std::prev(next);
+			if(prev->first + prev->second == offset) {
+				prev->second += size;
+				size = 0;
+			}
+		}
+		if(size > 0) regions[offset] = size;
+	}
+	returned.notify_all();
+}
+
+wdedup::MemoryLease MemoryBudget::acquire(size_t size) {
+	size_t rounded = (size + alignment - 1) / alignment * alignment;
+
+	// Wait until the memory has been returned by other leases, or the
+	// request could never be satisfied after resizing.
+	wdedup::MemoryLease lease;
+	std::unique_lock<std::mutex> lock(mutex);
+	returned.wait(lock, [&]() { 
+		if(size == 0 || rounded > limit) return true;
+		return (lease.region = place(rounded)) != nullptr; });
+	if(lease.region == nullptr)
+		throw std::logic_error("Insufficient working memory.");
+	lease.budget = this; lease.length = rounded;
+	return lease;
+}
+
+wdedup::MemoryLease MemoryBudget::tryAcquire(size_t size) noexcept {
+	size_t rounded = (size + alignment - 1) / alignment * alignment;
+	wdedup::MemoryLease lease;
+	std::lock_guard<std::mutex> lock(mutex);
+	if(size == 0 || rounded > limit) return lease;
+	lease.region = place(rounded);
+	if(lease.region != nullptr) {
+		lease.budget = this; lease.length = rounded;
+	}
+	return lease;
+}
+
+size_t ioShare(size_t workmem, size_t files, size_t buffer) noexcept {
+	size_t share = std::min(files * buffer, workmem / 4);
+	return share / MemoryBudget::alignment * MemoryBudget::alignment;
+}
+
+} // namespace wdedup
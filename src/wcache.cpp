@@ -0,0 +1,160 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wcache.cpp
+ * @author Haoran Luo
+ * @brief wdedup Simple Segment Cache Implementation
+ *
+ * See corresponding header for interface definitions.
+ */
+#include "impl/wcache.hpp"
+#include "impl/wpflsimple.hpp"
+#include "wdedup.hpp"
+#include <cstdio>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wdedup {
+
+/// Prefix of the cached profile, which should be changed whenever
+/// the format of the profile has been changed. The profiles with 
+/// the number of occurences are cached separately.
+static const char* cachePrefix = "simple-";
+static const char* countedPrefix = "simple-counted-";
+
+/// Suffix of the occupancy stored beside the cached profile. The
+/// profiles cached without it are taken as of unknown occupancy.
+static const char* occupancySuffix = ".occupancy";
+
+/// Write out the occupancy under the temporary path, and publish it.
+static void storeOccupancy(const std::string& temp, const std::string& path,
+	wdedup::FileMode mode, wdedup::SegmentOccupancy o) throw (wdedup::Error) {
+	unlink(temp.c_str()); {
+		wdedup::AppendFile file(temp, "segment-cache", mode);
+		std::vector<uint64_t*> fields = o.fields();
+		uint64_t count = fields.size();
+		file << wdedup::varint(count);
+		for(size_t i = 0; i < fields.size(); ++ i) 
+			file << wdedup::varint(*fields[i]);
+		file << wdedup::sync;
+	}
+	if(rename(temp.c_str(), path.c_str()) < 0)
+		throw wdedup::Error(errno, path, "segment-cache");
+}
+
+/// Read the occupancy stored under the path if it exists.
+static void loadOccupancy(const std::string& path, wdedup::FileMode mode, 
+	wdedup::SegmentOccupancy& o) throw (wdedup::Error) {
+	if(access(path.c_str(), R_OK) < 0) {
+		if(errno == ENOENT) return;
+		throw wdedup::Error(errno, path, "segment-cache");
+	}
+	wdedup::SequentialFile file(path, "segment-cache", mode);
+	std::vector<uint64_t*> fields = o.fields();
+	uint64_t count, value; file >> wdedup::varint(count);
+	for(uint64_t i = 0; i < count; ++ i) {
+		file >> wdedup::varint(value);
+		if(i < fields.size()) *fields[i] = value;
+	}
+}
+
+/// The profile output publishing the profile once closed.
+class CachedOutputSimple final : public wdedup::ProfileOutput {
+	/// The temporary path and the published path of the profile.
+	std::string temp, path;
+
+	/// The file mode and the occupancy stored beside the profile.
+	wdedup::FileMode mode;
+	wdedup::SegmentOccupancy occupancy;
+
+	/// The delegated profile output, reset once closed.
+	std::unique_ptr<wdedup::ProfileOutputSimple> delegated;
+public:
+	CachedOutputSimple(std::string temp, std::string path,
+		wdedup::FileMode mode, bool counting, 
+		wdedup::SegmentOccupancy occupancy) throw (wdedup::Error): 
+		temp(temp), path(std::move(path)), mode(mode), 
+		occupancy(occupancy), delegated(new wdedup::ProfileOutputSimple(
+		std::move(temp), mode, counting, false)) {}
+
+	virtual ~CachedOutputSimple() noexcept {
+		delegated.reset();
+		wdedup::profileRemoveSimple(temp);
+		unlink((temp + occupancySuffix).c_str());
+	}
+
+	virtual void push(wdedup::ProfileItem item) 
+			throw (wdedup::Error) override {
+		delegated->push(std::move(item));
+	}
+
+	virtual size_t close() throw (wdedup::Error) override {
+		size_t size = delegated->close();
+		delegated.reset();
+
+		// The occupancy is published first, so that the profile is
+		// never seen without it.
+		storeOccupancy(temp + occupancySuffix, 
+			path + occupancySuffix, mode, occupancy);
+		if(rename(temp.c_str(), path.c_str()) < 0)
+			throw wdedup::Error(errno, path, "segment-cache");
+		return size;
+	}
+};
+
+SegmentCacheSimple::SegmentCacheSimple(std::string dir, wdedup::FileMode mode,
+	bool counting) throw (wdedup::Error): dir(dir), mode(mode), 
+	counting(counting), prefix(counting? countedPrefix : cachePrefix) {
+	struct stat st; if(stat(dir.c_str(), &st) < 0) {
+		if(errno != ENOENT || mkdir(dir.c_str(), S_IRWXU) < 0)
+			throw wdedup::Error(errno, dir, "segment-cache");
+	} else if(!S_ISDIR(st.st_mode))
+		throw wdedup::Error(ENOTDIR, dir, "segment-cache");
+}
+
+std::unique_ptr<wdedup::ProfileInput> SegmentCacheSimple::openCached(
+	const std::string& key, wdedup::SegmentOccupancy& occupancy
+) throw (wdedup::Error) {
+	std::string path = dir + "/" + prefix + key;
+	if(access(path.c_str(), R_OK) < 0) {
+		if(errno == ENOENT) return nullptr;
+		throw wdedup::Error(errno, path, "segment-cache");
+	}
+	loadOccupancy(path + occupancySuffix, mode, occupancy);
+	return std::unique_ptr<wdedup::ProfileInput>(
+		new wdedup::ProfileInputSimple(path, mode));
+}
+
+std::unique_ptr<wdedup::ProfileOutput> SegmentCacheSimple::createCached(
+	const std::string& key, const wdedup::SegmentOccupancy& occupancy
+) throw (wdedup::Error) {
+	std::string path = dir + "/" + prefix + key;
+	std::string temp = dir + "/." + prefix + key + 
+		"." + std::to_string(getpid());
+	wdedup::profileRemoveSimple(temp);
+	return std::unique_ptr<wdedup::ProfileOutput>(
+		new CachedOutputSimple(temp, path, mode, counting, occupancy));
+}
+
+} // namespace wdedup
@@ -28,12 +28,15 @@
  * corresponding header for implementation details.
  */
 #include "impl/wcli.hpp"
+#include "impl/wtune.hpp"
 #include <boost/program_options.hpp>
 #include <vector>
 #include <regex>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 
 // Helper for fully replacing components inside string.
 static inline void strsub(std::string& str,
@@ -46,7 +49,7 @@ static inline void strsub(std::string& str,
 }
 
 // Helper for converting string into memory size.
-static inline size_t strsize(std::string str) {
+size_t wdedup::strsize(std::string str) {
 	std::regex rememsize("(\\d+)([kKmMgGtT])?[bB]?");
 	std::smatch result; if(std::regex_match(str, result, rememsize)) {
 		std::string num, unit(" ");
@@ -66,6 +69,204 @@ static inline size_t strsize(std::string str) {
 
 namespace wdedup {
 
+// Parses the command line argument of the query subcommand.
+static int queryparse(int argc, char** argv, wdedup::ProgramOptions& options) {
+	namespace po = boost::program_options;
+	options.run = true;
+	options.query = true;
+
+	// Other stages are disabled while querying.
+	options.workmem = strsize(wdedup::minWorkmem);
+	options.syncDistance = 0;
+	options.syncTuned = false;
+	options.pagePinned = false;
+	options.memoryPressure = false;
+	options.overlapPour = false;
+	options.topN = 1;
+	options.listAll = false;
+	options.verifyFirst = 0;
+	options.profileOnly = false;
+	options.mergeOnly = false;
+	options.disableGC = true;
+	options.stats = "";
+	options.progress = "";
+	options.trace = "";
+	options.incremental = false;
+	options.countWords = false;
+	options.topK = 0;
+	options.countUnique = false;
+	options.cacheDir = "";
+	options.tune = false;
+	options.tuning = "";
+
+	// Configurable arguments for this subcommand.
+	bool help = false;
+	typedef std::vector<std::string> positionalHolder;
+	positionalHolder workdir;
+
+	// Initialize positional arguments.
+	po::options_description positionals("Positional Arguments");
+	positionals.add_options()
+		("workdir", po::value<positionalHolder>(&workdir),
+			"Specifies the working directory of a finished task, "
+			"whose final profile will be looked up.")
+		("word", po::value<positionalHolder>(&options.words),
+			"The words to look up. When no word is specified, the "
+			"words will be read from standard input, one word "
+			"per line.");
+
+	// Initialize optional flags.
+	po::options_description optionals("Options");
+	optionals.add_options()
+		("help,h", po::bool_switch(&help), "Print this help message.")
+		("threads,t", po::value<size_t>(&options.threads)->default_value(0),
+			"Configure how many threads would be used to look up "
+			"words. When set to 0, the number of processors will "
+			"be used.")
+		("affinity", po::bool_switch(&options.affinity),
+			"Pin the threads to the processors available to the "
+			"process, one thread per processor in turn.");
+
+	// Aggregate as argument parser.
+	po::options_description usage;
+	usage.add(positionals).add(optionals);
+
+	// Retrieve a formatted help message.
+	auto getHelpMessage = [&]() -> std::string {
+		std::stringstream fmt;
+		fmt << "Usage: " << argv[0] << " query [--flags] WORKDIR [WORD...]" 
+			<< std::endl
+			<< "Looks up words in the final profile, printing "
+			<< "whether each word is unique, repeated or absent, "
+			<< "and the first occurence of unique words."
+			<< std::endl << usage << std::endl;
+
+		std::string result = fmt.str();
+		strsub(result,	"--workdir arg", 
+				"WORKDIR      ");
+		strsub(result,	"--word arg",
+				"WORD...   ");
+		return result;
+	};
+
+	// Attempt to perform parsing.
+	try {
+		po::variables_map vm;
+		po::positional_options_description pod;
+		pod.add("workdir", 1); pod.add("word", -1);
+		po::store(po::command_line_parser(argc - 1, argv + 1).
+			options(usage).positional(pod).run(), vm);
+		po::notify(vm);
+
+		// Print out help message if required.
+		if(help) {
+			std::cerr << getHelpMessage();
+			options.run = false;
+			return 0;
+		}
+
+		// Take the positional arguments.
+		if(workdir.size() >= 1) options.workdir = workdir[0];
+		else throw std::logic_error("WORKDIR must be specified");
+
+		// Use the number of processors when threads is not specified.
+		if(options.threads == 0) options.threads = 
+			std::max(std::thread::hardware_concurrency(), 1u);
+	} catch(std::logic_error& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		std::cerr << getHelpMessage();
+		return -1;
+	}
+
+	return 0;
+}
+
+// Parses the command line argument of the tune subcommand.
+static int tuneparse(int argc, char** argv, wdedup::ProgramOptions& options) {
+	namespace po = boost::program_options;
+	options.run = true;
+	options.query = false;
+	options.tune = true;
+
+	// Configurable arguments for this subcommand.
+	bool help = false;
+	typedef std::vector<std::string> positionalHolder;
+	positionalHolder scratch;
+
+	// Initialize positional arguments.
+	po::options_description positionals("Positional Arguments");
+	positionals.add_options()
+		("scratchdir", po::value<positionalHolder>(&scratch),
+			"Specifies the scratch directory where the calibration "
+			"files are written and read, which should be on the same "
+			"disk as the working directories.");
+
+	// Initialize optional flags.
+	po::options_description optionals("Options");
+	optionals.add_options()
+		("help,h", po::bool_switch(&help), "Print this help message.")
+		("size,s", po::value<std::string>()->default_value("256m"),
+			"Configure the size of the calibration file. It should be "
+			"large enough to measure the disk rather than the cache.")
+		("tuning", po::value<std::string>(&options.tuning)
+			->default_value(wdedup::tuningPath()),
+			"The path where the tuning profile is written.");
+
+	// Aggregate as argument parser.
+	po::options_description usage;
+	usage.add(positionals).add(optionals);
+
+	// Retrieve a formatted help message.
+	auto getHelpMessage = [&]() -> std::string {
+		std::stringstream fmt;
+		fmt << "Usage: " << argv[0] << " tune [--flags] SCRATCHDIR" 
+			<< std::endl
+			<< "Measures the disk and processor of the host with short "
+			<< "calibrations, and writes the tuning profile that later "
+			<< "tasks load automatically."
+			<< std::endl << usage << std::endl;
+
+		std::string result = fmt.str();
+		strsub(result,	"--scratchdir arg", 
+				"SCRATCHDIR      ");
+		return result;
+	};
+
+	// Attempt to perform parsing.
+	try {
+		po::variables_map vm;
+		po::positional_options_description pod;
+		pod.add("scratchdir", 1);
+		po::store(po::command_line_parser(argc - 1, argv + 1).
+			options(usage).positional(pod).run(), vm);
+		po::notify(vm);
+
+		// Print out help message if required.
+		if(help) {
+			std::cerr << getHelpMessage();
+			options.run = false;
+			return 0;
+		}
+
+		// Take the positional arguments.
+		if(scratch.size() >= 1) options.workdir = scratch[0];
+		else throw std::logic_error("SCRATCHDIR must be specified");
+		if(options.tuning == "") 
+			throw std::logic_error("The tuning profile must be specified");
+
+		// Parse the size of calibration file.
+		options.tuneSize = strsize(vm["size"].as<std::string>());
+		if(options.tuneSize < (1 << 20))
+			throw std::logic_error("At least 1MB calibration file is required.");
+	} catch(std::logic_error& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		std::cerr << getHelpMessage();
+		return -1;
+	}
+
+	return 0;
+}
+
 /**
  * @brief Parses the command line argument of wdedup.
  *
@@ -76,12 +277,19 @@ namespace wdedup {
  */
 int argparse(int argc, char** argv, wdedup::ProgramOptions& options) {
 	namespace po = boost::program_options;
+	if(argc > 1 && std::string(argv[1]) == "query")
+		return queryparse(argc, argv, options);
+	if(argc > 1 && std::string(argv[1]) == "tune")
+		return tuneparse(argc, argv, options);
 	options.run = true;
+	options.query = false;
+	options.tune = false;
 
 	// Configurable arguments for this application.
 	bool help = false;
 	typedef std::vector<std::string> positionalHolder;
 	positionalHolder origfile, workdir;
+	std::vector<std::string> bufferSizes;
 
 	// Initialize positional arguments.
 	po::options_description positionals("Positional Arguments");
@@ -106,10 +314,108 @@ int argparse(int argc, char** argv, wdedup::ProgramOptions& options) {
 		("page-pinned,p", po::bool_switch(&options.pagePinned),
 			"Configure whether the working memory should be page "
 			"pinned (not swapped out and resides in RAM).")
+		("memory-pressure,r", po::bool_switch(&options.memoryPressure),
+			"Watch the memory pressure of the cgroup (v2) of the "
+			"process, shrinking the working memory between profile "
+			"segments under pressure and growing it back up to the "
+			"configured size once the pressure is relieved. It "
+			"could not be used with page pinning.")
+		("threads,t", po::value<size_t>(&options.threads)->default_value(0),
+			"Configure how many threads would be in the thread pool, "
+			"which runs the tasks of every stage, like scanning the "
+			"final profile and sorting runs. When set to 0, the "
+			"number of processors will be used.")
+		("affinity", po::bool_switch(&options.affinity),
+			"Pin the threads of the thread pool to the processors "
+			"available to the process, one thread per processor "
+			"in turn.")
+		("overlap-pour", po::bool_switch(&options.overlapPour),
+			"Fill the next profile segment while the previous one "
+			"is poured out by another thread. Each segment gets "
+			"half of the working memory, so there will be twice "
+			"as many segments to merge. It takes effect only "
+			"with more than one thread.")
+		("top-n,n", po::value<size_t>(&options.topN)->default_value(1),
+			"Configure how many non-repeating words would be found. "
+			"The words will be printed in order of their first "
+			"occurence, one word per line.")
+		("list-all,a", po::bool_switch(&options.listAll),
+			"Print all non-repeating words in order of their first "
+			"occurence. The words will be sorted externally under "
+			"the working directory.")
+		("count-words,w", po::bool_switch(&options.countWords),
+			"Record the number of occurences of repeated words in "
+			"the profiles, so that the most frequent words could "
+			"be found. It must be specified since profiling, and "
+			"the working directory is rejected if it is profiled "
+			"otherwise.")
+		("top-k,k", po::value<size_t>(&options.topK)->default_value(0),
+			"Configure how many most frequent words would be found. "
+			"The words will be printed in descending order of their "
+			"number of occurences, with the number after the word. "
+			"Requires --count-words.")
+		("count-unique,u", po::bool_switch(&options.countUnique),
+			"Print the number of distinct words and non-repeating "
+			"words. When combined with --top-n or --top-k, all of "
+			"them are answered in a single scan of the final profile, "
+			"and each result is printed after a \"# name\" line.")
+		("verify-first,v", po::value<size_t>(&options.verifyFirst)
+			->default_value(0),
+			"Configure how many of the earliest non-repeating words "
+			"of the first profile segment would be verified against "
+			"other segments before merging. The first word found "
+			"absent from other segments will be printed without "
+			"merging. When set to 0, such verification is disabled.")
+		("incremental,i", po::bool_switch(&options.incremental),
+			"Treat the original file as append-only. When it has "
+			"grown since the working directory was processed, only "
+			"the appended content will be profiled and merged with "
+			"the previous result. The working directory could not "
+			"grow after --list-all has been performed on it.")
+		("cache-dir,c", po::value<std::string>(&options.cacheDir)
+			->default_value(""),
+			"Configure the directory of segment cache, which could "
+			"be shared by tasks on overlapping files. The file will "
+			"be divided into chunks by content, and the profile of "
+			"chunks found in the cache will not be generated again.")
+		("stats", po::value<std::string>(&options.stats)
+			->default_value("")->implicit_value("json"),
+			"Print a statistics report to standard error after the "
+			"task, measuring the time, I/O and records of each stage "
+			"and each merge. Only \"json\" format is supported, "
+			"which should be specified as --stats=json when it "
+			"precedes the positional arguments.")
+		("progress", po::value<std::string>(&options.progress)
+			->default_value(""),
+			"Export the progress of the task to the specified file "
+			"every 10 seconds, in Prometheus text format, so that it "
+			"could be collected by the textfile collector. The file "
+			"is replaced atomically with a temporary file beside it.")
+		("trace", po::value<std::string>(&options.trace)
+			->default_value(""),
+			"Record the spans of filling and pouring segments, merging, "
+			"fsync, planning and scanning of each thread, and write "
+			"them to the specified file in Chrome trace event format "
+			"after the task, which could be opened by Perfetto UI.")
+		("buffer-size", po::value<std::vector<std::string>>(&bufferSizes),
+			"Configure the buffer size of files of a role, as ROLE=SIZE, "
+			"which could be specified multiple times. The roles are "
+			"\"original-file\", \"log\", \"profile-simple\", "
+			"\"profile-index\" and \"profile-filter\". Files are "
+			"buffered by 4KB if not configured.")
+		("tuning", po::value<std::string>(&options.tuning)
+			->default_value(wdedup::tuningPath()),
+			"Load the tuning profile measured by \"wdedup tune\" if it "
+			"exists, whose buffer sizes and synchronization distance "
+			"are taken unless specified by --buffer-size and "
+			"--sync-distance. Set to empty string to ignore the profile.")
 		("sync-distance,d", po::value<std::string>()->default_value("2g"),
 			"Configure how many bytes (from original file) would "
 			"be processed before a synchronization will be performed. "
-			"When set to 0, such synchronization will be disabled.");
+			"When set to 0, such synchronization will be disabled. "
+			"When not specified, the distance is chosen by the tuning "
+			"profile so that synchronizing takes no more than 1% of "
+			"profiling, if the profile has been measured.");
 
 	// Initialize debug flags (used for debugging purpose).
 	po::options_description debugs("Debug Flags");
@@ -162,6 +468,14 @@ int argparse(int argc, char** argv, wdedup::ProgramOptions& options) {
 			return 0;
 		}
 
+		// Make sure the statistics report format is supported. It is
+		// checked before the positional arguments, since "--stats FILE"
+		// takes FILE as the format.
+		if(options.stats != "" && options.stats != "json")
+			throw std::logic_error("Unsupported statistics format: \"" 
+				+ options.stats + "\", the format should be specified "
+				"as --stats=json.");
+
 		// Take the positional arguments.
 		if(origfile.size() >= 1) options.origfile = origfile[0];
 		else throw std::logic_error("FILE must be specified");
@@ -178,9 +492,44 @@ int argparse(int argc, char** argv, wdedup::ProgramOptions& options) {
 			throw std::logic_error(wmerr.str());
 		}
 
+		// Parse the buffer sizes of roles, and make sure they are valid.
+		for(const std::string& bufferSize : bufferSizes) {
+			size_t eq = bufferSize.find('=');
+			if(eq == std::string::npos) throw std::logic_error(
+				"Malformed buffer size: \"" + bufferSize + "\".");
+			std::string role = bufferSize.substr(0, eq);
+			size_t size = strsize(bufferSize.substr(eq + 1));
+			if(role != "original-file" && role != "log" && role != 
+				"profile-simple" && role != "profile-index" && role != 
+				"profile-filter") throw std::logic_error(
+				"Unknown role of buffer size: \"" + role + "\".");
+			if(size == 0) throw std::logic_error(
+				"Buffer size of \"" + role + "\" should not be 0.");
+			options.bufferSizes[role] = size;
+		}
+
+		// Pinned pages cannot be returned when the budget shrinks.
+		if(options.pagePinned && options.memoryPressure)
+			throw std::logic_error("The working memory under memory "
+				"pressure should not be page pinned.");
+
+		// Make sure at least one word is required.
+		if(options.topN == 0)
+			throw std::logic_error("At least 1 word must be found.");
+
+		// The most frequent words could only be found by the number of
+		// occurences, which is recorded only with --count-words.
+		if(options.topK > 0 && !options.countWords)
+			throw std::logic_error("--top-k requires --count-words.");
+
+		// Use the number of processors when threads is not specified.
+		if(options.threads == 0) options.threads = 
+			std::max(std::thread::hardware_concurrency(), 1u);
+
 		// Parse the synchronization distance, and make sure it is no less 
 		// than minSyncDistance.
 		options.syncDistance = strsize(vm["sync-distance"].as<std::string>());
+		options.syncTuned = vm["sync-distance"].defaulted();
 		if(options.syncDistance != 0 && options.syncDistance < 
 			strsize(wdedup::minSyncDistance)) {
 			std::stringstream wmerr;
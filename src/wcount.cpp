@@ -0,0 +1,69 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wcount.cpp
+ * @author Haoran Luo
+ * @brief wdedup Count Implementation
+ *
+ * This file implements the counting function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wfind.hpp"
+#include <string>
+#include <vector>
+
+namespace wdedup {
+
+void CountConsumer::consume(size_t worker, wdedup::ProfileItem item) {
+	Local& local = locals[worker];
+	++ local.distinct;
+	if(!item.repeated) ++ local.singular;
+}
+
+std::pair<size_t, size_t> CountConsumer::result() const noexcept {
+	std::pair<size_t, size_t> result(0, 0);
+	for(size_t i = 0; i < locals.size(); ++ i) {
+		result.first += locals[i].distinct;
+		result.second += locals[i].singular;
+	}
+	return result;
+}
+
+std::pair<size_t, size_t> wcount(
+	wdedup::Config& cfg, size_t root, size_t threads
+) throw (wdedup::Error) {
+	// Every block must be visited, so they are visited in file order
+	// and workers could read adjacent blocks through the same input.
+	std::string path = std::to_string(root);
+	std::vector<wdedup::ProfileBlock> blocks = cfg.openIndex(path);
+	std::vector<size_t> order(blocks.size());
+	for(size_t i = 0; i < order.size(); ++ i) order[i] = i;
+
+	// Perform scanning on the blocks and sum up the counters.
+	if(threads == 0) threads = 1;
+	CountConsumer consumer(threads);
+	wdedup::wscan(cfg, path, blocks, order, threads, consumer);
+	return consumer.result();
+}
+
+} // namespace wdedup
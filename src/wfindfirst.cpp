@@ -28,35 +28,57 @@
  * for more definition details.
  */
 #include "wdedup.hpp"
+#include "impl/wfind.hpp"
 #include <string>
+#include <vector>
 
 namespace wdedup {
 
-std::string wfindfirst(
-	wdedup::Config& cfg, size_t root
-) throw (wdedup::Error) {
-	// Open the final merged result and find the first element.
-	std::unique_ptr<wdedup::ProfileInput> singular =
-		cfg.openSingularInput(std::to_string(root));
-
-	// Perform sequential scanning and fetch the entry with lowest
-	// occurence offset.
-	std::string result; fileoff_t off = 0;
-	while(!singular->empty()) {
-		wdedup::ProfileItem item = singular->pop();
-
-		// Judge whether current item should replace the current.
-		bool replace = false;
-		if(result == "") replace = true;
-		else if(off > item.occur) replace = true;
-
-		// Replace the current item.
-		if(replace) {
-			result = item.word;
-			off = item.occur;
+bool FindFirstConsumer::accept(size_t, 
+		const wdedup::ProfileBlock& block) noexcept {
+	return block.minOccur < bound.load();
+}
+
+void FindFirstConsumer::consume(size_t worker, wdedup::ProfileItem item) {
+	Local& local = locals[worker];
+	if(item.repeated || item.occur >= local.occur) return;
+	local.word = std::move(item.word);
+	local.occur = item.occur;
+
+	// Lower the shared bound if current one is lower.
+	fileoff_t current = bound.load();
+	while(local.occur < current && 
+		!bound.compare_exchange_weak(current, local.occur));
+}
+
+std::string FindFirstConsumer::result() const {
+	std::string result; fileoff_t off = ProfileBlock::none;
+	for(size_t i = 0; i < locals.size(); ++ i)
+		if(locals[i].occur < off) {
+			result = locals[i].word;
+			off = locals[i].occur;
 		}
-	}
 	return result;
 }
 
+std::string wfindfirst(
+	wdedup::Config& cfg, size_t root, size_t threads
+) throw (wdedup::Error) {
+	// Retrieve the block summaries of the final merged result.
+	std::string path = std::to_string(root);
+	std::vector<wdedup::ProfileBlock> blocks = cfg.openIndex(path);
+
+	// Visit the blocks in ascending order of their minimum occurence,
+	// so that the scanning could stop once the current result is 
+	// lower than the minimum occurence of every remaining block.
+	std::vector<size_t> order = wdedup::occurOrder(blocks);
+
+	// Perform scanning on the blocks and reduce the entries with 
+	// lowest occurence offset of each worker.
+	if(threads == 0) threads = 1;
+	FindFirstConsumer consumer(threads);
+	wdedup::wscan(cfg, path, blocks, order, threads, consumer);
+	return consumer.result();
+}
+
 } // namespace wdedup
@@ -0,0 +1,112 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wfindtopk.cpp
+ * @author Haoran Luo
+ * @brief wdedup Find-TopK Implementation
+ *
+ * This file implements the finding function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wfind.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+
+namespace wdedup {
+
+bool FindTopKConsumer::accept(size_t, 
+		const wdedup::ProfileBlock& block) noexcept {
+	// The block without recorded count could not be pruned, and it
+	// will be reported while reducing the result.
+	if(block.maxCount == 0) { uncounted.store(true); return false; }
+	return block.maxCount >= bound.load();
+}
+
+void FindTopKConsumer::consume(size_t worker, wdedup::ProfileItem item) {
+	std::vector<Entry>& heap = heaps[worker];
+	Entry entry;
+	entry.count = item.count;
+	if(heap.size() == k) {
+		if(entry.count < heap.front().count) return;
+		entry.word = std::move(item.word);
+		if(!(entry < heap.front())) return;
+		std::pop_heap(heap.begin(), heap.end());
+		heap.pop_back();
+	} else entry.word = std::move(item.word);
+
+	// Place the item into the heap.
+	heap.push_back(std::move(entry));
+	std::push_heap(heap.begin(), heap.end());
+
+	// Raise the shared bound if the heap is full.
+	if(heap.size() < k) return;
+	size_t top = heap.front().count;
+	size_t current = bound.load();
+	while(top > current && !bound.compare_exchange_weak(current, top));
+}
+
+std::vector<std::pair<std::string, size_t>> FindTopKConsumer::result(
+	const std::string& path) throw (wdedup::Error) {
+	if(uncounted.load()) throw wdedup::Error(ENODATA, path, "profile-count");
+
+	// Merge the heaps of workers, which are consumed by merging.
+	std::vector<Entry> merged;
+	for(size_t i = 0; i < heaps.size(); ++ i) {
+		for(size_t j = 0; j < heaps[i].size(); ++ j)
+			merged.push_back(std::move(heaps[i][j]));
+		heaps[i].clear();
+	}
+	std::sort(merged.begin(), merged.end());
+
+	// Collect the most frequent k words.
+	std::vector<std::pair<std::string, size_t>> result;
+	for(size_t i = 0; i < merged.size() && i < k; ++ i)
+		result.push_back(std::make_pair(
+			std::move(merged[i].word), merged[i].count));
+	return result;
+}
+
+std::vector<std::pair<std::string, size_t>> wfindtopk(
+	wdedup::Config& cfg, size_t root, size_t k, size_t threads
+) throw (wdedup::Error) {
+	if(k == 0) return std::vector<std::pair<std::string, size_t>>();
+
+	// Retrieve the block summaries of the final merged result, which
+	// must have recorded the number of occurences of every item.
+	std::string path = std::to_string(root);
+	std::vector<wdedup::ProfileBlock> blocks = cfg.openIndex(path);
+	for(size_t i = 0; i < blocks.size(); ++ i)
+		if(blocks[i].maxCount == 0) 
+			throw wdedup::Error(ENODATA, path, "profile-count");
+	std::vector<size_t> order = wdedup::countOrder(blocks);
+
+	// Perform scanning on the blocks and merge the heaps of workers.
+	if(threads == 0) threads = 1;
+	FindTopKConsumer consumer(threads, k);
+	wdedup::wscan(cfg, path, blocks, order, threads, consumer);
+	return consumer.result(path);
+}
+
+} // namespace wdedup
@@ -0,0 +1,101 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wfindtopn.cpp
+ * @author Haoran Luo
+ * @brief wdedup Find-TopN Implementation
+ *
+ * This file implements the finding function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wfind.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace wdedup {
+
+bool FindTopNConsumer::accept(size_t, 
+		const wdedup::ProfileBlock& block) noexcept {
+	return block.minOccur < bound.load();
+}
+
+void FindTopNConsumer::consume(size_t worker, wdedup::ProfileItem item) {
+	std::vector<Entry>& heap = heaps[worker];
+	if(item.repeated) return;
+	if(heap.size() == n) {
+		if(item.occur >= heap.front().occur) return;
+		std::pop_heap(heap.begin(), heap.end());
+		heap.pop_back();
+	}
+
+	// Place the item into the heap.
+	Entry entry;
+	entry.occur = item.occur;
+	entry.word = std::move(item.word);
+	heap.push_back(std::move(entry));
+	std::push_heap(heap.begin(), heap.end());
+
+	// Lower the shared bound if the heap is full.
+	if(heap.size() < n) return;
+	fileoff_t top = heap.front().occur;
+	fileoff_t current = bound.load();
+	while(top < current && !bound.compare_exchange_weak(current, top));
+}
+
+std::vector<std::string> FindTopNConsumer::result() {
+	// Merge the heaps of workers, which are consumed by merging.
+	std::vector<Entry> merged;
+	for(size_t i = 0; i < heaps.size(); ++ i) {
+		for(size_t j = 0; j < heaps[i].size(); ++ j)
+			merged.push_back(std::move(heaps[i][j]));
+		heaps[i].clear();
+	}
+	std::sort(merged.begin(), merged.end());
+
+	// Collect the earliest n words.
+	std::vector<std::string> result;
+	for(size_t i = 0; i < merged.size() && i < n; ++ i)
+		result.push_back(std::move(merged[i].word));
+	return result;
+}
+
+std::vector<std::string> wfindtopn(
+	wdedup::Config& cfg, size_t root, size_t n, size_t threads
+) throw (wdedup::Error) {
+	if(n == 0) return std::vector<std::string>();
+
+	// Retrieve the block summaries of the final merged result, and
+	// visit them in ascending order of their minimum occurence.
+	std::string path = std::to_string(root);
+	std::vector<wdedup::ProfileBlock> blocks = cfg.openIndex(path);
+	std::vector<size_t> order = wdedup::occurOrder(blocks);
+
+	// Perform scanning on the blocks and merge the heaps of workers.
+	if(threads == 0) threads = 1;
+	FindTopNConsumer consumer(threads, n);
+	wdedup::wscan(cfg, path, blocks, order, threads, consumer);
+	return consumer.result();
+}
+
+} // namespace wdedup
@@ -0,0 +1,258 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wgrow.cpp
+ * @author Haoran Luo
+ * @brief wdedup Grow Implementation
+ *
+ * This file implements the growing function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wmpdp.hpp"
+#include "impl/wprogress.hpp"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wdedup {
+
+/**
+ * @brief Indicates the type of current log item.
+ *
+ * Each generation is started with such item, followed by the log
+ * items of wprof and wmerge of the generation.
+ */
+enum class WGrowLog : char {
+	/**
+	 * @brief Records the start of a generation.
+	 *
+	 * The log should be of format 
+	 * ```c++
+	 * struct {
+	 *     offset_type start;
+	 *     size_t id, size;
+	 * };
+	 * ```
+	 * Where start is the offset that the generation is profiled
+	 * from, id is the id of the first segment of the generation,
+	 * and size is the size of the final profile of previous
+	 * generation.
+	 *
+	 * The start is the offset of appended content, unless the
+	 * appended content continues the last word of the profiled
+	 * content. Then it is rewound to the start of that word, whose
+	 * occurence is trimmed from the previous final profile, or it
+	 * is 0 when the occurence could not be trimmed and the whole
+	 * file is profiled again.
+	 */
+	generation = 'g',
+
+	/**
+	 * @brief Records the trimmed previous final profile.
+	 *
+	 * The log should be of format
+	 * ```c++
+	 * struct {
+	 *     size_t size;
+	 * };
+	 * ```
+	 * Which follows the generation item whose start has been 
+	 * rewound, and the size is the size of the trimmed profile 
+	 * whose id precedes the id of the first segment.
+	 */
+	trimmed = 't'
+};
+
+/// Find the last word of the profiled content if the appended 
+/// content continues it, returning false if there's no such word.
+static bool straddling(const std::string& path, fileoff_t covered,
+	fileoff_t& wordStart, std::string& word) throw (wdedup::Error) {
+	static const char* role = "original-file";
+	if(covered == 0) return false;
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw wdedup::Error(errno, path, role);
+	try {
+		// Read the first appended character.
+		char c;
+		ssize_t n = pread(fd, &c, 1, covered);
+		if(n < 0) throw wdedup::Error(errno, path, role);
+		if(n == 0) throw wdedup::Error(EIO, path, role);
+		if(isWhitespace(c)) { close(fd); return false; }
+
+		// Read backward until the whitespace before the word.
+		char buffer[4096];
+		wordStart = covered; word.clear();
+		while(wordStart > 0) {
+			size_t length = std::min<size_t>(sizeof(buffer), wordStart);
+			n = pread(fd, buffer, length, wordStart - length);
+			if(n < 0) throw wdedup::Error(errno, path, role);
+			if((size_t)n < length) throw wdedup::Error(EIO, path, role);
+			size_t i = length;
+			while(i > 0 && !isWhitespace(buffer[i - 1])) -- i;
+			word.insert(0, buffer + i, length - i);
+			wordStart -= length - i;
+			if(i > 0) break;
+		}
+	} catch(wdedup::Error) {
+		close(fd); throw;
+	}
+	close(fd);
+	return word.size() > 0;
+}
+
+/// Copy the final profile of previous generation, with the occurence
+/// of the straddling word removed, returning the size of the copy.
+static size_t trim(wdedup::Config& cfg, size_t root, size_t trimmed,
+	const std::string& word) throw (wdedup::Error) {
+	std::unique_ptr<wdedup::ProfileInput> in = 
+		cfg.openInput(std::to_string(root));
+	cfg.remove(std::to_string(trimmed));
+	std::unique_ptr<wdedup::ProfileOutput> out = 
+		cfg.openOutput(std::to_string(trimmed));
+	while(!in->empty()) {
+		wdedup::ProfileItem item = in->pop();
+		if(item.word == word) {
+			if(!item.repeated) continue;
+			-- item.count;
+		}
+		out->push(std::move(item));
+	}
+	return out->close();
+}
+
+size_t wgrow(
+	wdedup::Config& cfg, const std::string& path,
+	const std::vector<wdedup::ProfileSegment>& segments, 
+	size_t root, size_t syncDistance, bool disableGC, bool grow
+) throw (wdedup::Error) {
+	// The offset of original file that has been profiled.
+	fileoff_t covered = segments.back().end + 1;
+
+	// Check whether the original file has grown since profiled.
+	auto grown = [&]() -> bool {
+		static const char* role = "original-file";
+		struct stat st; if(stat(path.c_str(), &st) < 0)
+			throw wdedup::Error(errno, path, role);
+		if((fileoff_t)st.st_size < covered)
+			throw wdedup::Error(EIO, path, role);
+		return (fileoff_t)st.st_size > covered;
+	};
+
+	while(true) {
+		fileoff_t start; size_t id, size;
+		if(!cfg.hasRecoveryDone() && !cfg.ilog().eof()) {
+			// Peek the type of next item, which could also be 
+			// the log item of the final stages.
+			char* type = nullptr; size_t length = 0;
+			cfg.ilog().bufferptr(type, length);
+			if(length == 0 || *type != (char)WGrowLog::generation) {
+				// The generation could not be recorded after them,
+				// as their results would be discarded.
+				if(grow && grown()) throw wdedup::Error(ENOTSUP, path,
+					"grown after the task has finished, "
+					"which requires a new working directory");
+				return root;
+			}
+			
+			// Parse the generation parameters.
+			char generation; cfg.ilog() >> generation;
+			cfg.ilog() >> start >> id >> size;
+			if(start > covered || id <= root) cfg.logCorrupt();
+		} else {
+			// Start a new generation if the original file has grown.
+			if(!grow || !grown()) return root;
+			cfg.recoveryDone();
+
+			// Rewind to the word continued by the appended content,
+			// if its occurence could be trimmed, which is impossible
+			// when it becomes singular or its count is not recorded.
+			start = covered; id = root + 1; 
+			fileoff_t wordStart; std::string word;
+			if(straddling(path, covered, wordStart, word)) {
+				wdedup::ProfileItem item(word);
+				if(cfg.openLookup(std::to_string(root))->find(word, item)
+					&& (item.repeated? item.count > 2 : 
+						item.occur == wordStart)) {
+					start = wordStart; id = root + 2;
+				} else start = 0;
+			}
+
+			// Record the start of new generation.
+			size = 0;
+			std::vector<wdedup::ProfileBlock> blocks = 
+				cfg.openIndex(std::to_string(root));
+			for(size_t i = 0; i < blocks.size(); ++ i) 
+				size += blocks[i].size;
+			cfg.olog() << WGrowLog::generation << start 
+				<< id << size << wdedup::sync;
+		}
+
+		// Trim the previous final profile when rewound, or discard
+		// it when the whole file is profiled again.
+		size_t previousId = root;
+		if(start > 0 && start < covered) {
+			if(id <= root + 1) cfg.logCorrupt();
+			previousId = id - 1;
+			if(!cfg.hasRecoveryDone() && !cfg.ilog().eof()) {
+				char trimmed; cfg.ilog() >> trimmed;
+				if(trimmed != (char)WGrowLog::trimmed) cfg.logCorrupt();
+				cfg.ilog() >> size;
+			} else {
+				cfg.recoveryDone();
+				fileoff_t wordStart; std::string word;
+				if(!straddling(path, covered, wordStart, word) 
+					|| wordStart != start) cfg.logCorrupt();
+				size = trim(cfg, root, previousId, word);
+				cfg.olog() << WGrowLog::trimmed << size << wdedup::sync;
+			}
+		}
+		if(!disableGC && (start == 0 || start < covered)) 
+			cfg.remove(std::to_string(root));
+
+		// Profile the appended content into new segments.
+		std::vector<wdedup::ProfileSegment> generation = 
+			wdedup::wprof(cfg, path, syncDistance, start, id);
+		covered = generation.back().end + 1;
+
+		// Merge the new segments with the previous final profile, 
+		// which is taken as the segment of the profiled content.
+		if(start > 0) {
+			wdedup::ProfileSegment previous;
+			previous.id = previousId;
+			previous.start = 0;
+			previous.end = start - 1;
+			previous.size = size;
+			generation.insert(generation.begin(), previous);
+		}
+		wdedup::MergePlannerDP planner(cfg, std::move(generation));
+		cfg.progress().plan(planner.schedule());
+		root = wdedup::wmerge(cfg, planner, disableGC);
+	}
+}
+
+} // namespace wdedup
@@ -41,10 +41,11 @@ static inline std::function<void(int)> getReportFunction(
 SequentialFile::SequentialFile(std::string path, std::string role,
 	FileMode mode) throw (wdedup::Error) : pimpl(nullptr) {
 
-	// Initialize the basic append file.
+	// Initialize the basic sequential file.
+	size_t bufsize = mode.bufferSize(role);
 	pimpl = std::unique_ptr<SequentialFile::Impl>(
-		new SequentialFileBase(path.c_str(), 
-		getReportFunction(path, role), mode.seekset));
+		new SequentialFileBase(path.c_str(), getReportFunction(path, role), 
+		mode.seekset, bufsize > 0? bufsize : bufsiz));
 }
 
 AppendFile::AppendFile(std::string path, std::string role, 
@@ -57,9 +58,10 @@ AppendFile::AppendFile(std::string path, std::string role,
 			getReportFunction(path, role)));
 	} else {
 		// Initialize the buffer append file.
+		size_t bufsize = mode.bufferSize(role);
 		pimpl = std::unique_ptr<AppendFile::Impl>(
-			new AppendFileBuffer(path.c_str(), 
-			getReportFunction(path, role)));
+			new AppendFileBuffer(path.c_str(), getReportFunction(path, role),
+			bufsize > 0? bufsize : bufsiz));
 	}
 }
 
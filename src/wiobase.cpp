@@ -27,9 +27,13 @@
  * See corresponding header for interface definitions.
  */
 #include "impl/wiobase.hpp"
+#include "impl/wstats.hpp"
+#include "impl/wtrace.hpp"
+#include "impl/wprobe.hpp"
 #include <cstring>
 #include <cassert>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -37,14 +41,22 @@
 namespace wdedup {
 
 SequentialFileBase::SequentialFileBase(
-	const char* path, std::function<void(int)> report, fileoff_t seekset
-) throw (wdedup::Error): report(report), 
-	fd(open(path, O_RDONLY)), readoff(0), readlen(0), filetell(0) {
+	const char* path, std::function<void(int)> report, 
+	fileoff_t seekset, size_t bufsize
+) throw (wdedup::Error): report(report), fd(open(path, O_RDONLY)), 
+	bufsize(bufsize), readbuf(new char[bufsize]), filesize((fileoff_t)(-1)),
+	readoff(0), readlen(0), filetell(0) {
 	
 	// Attempt to open the sequential file first. Exception will
 	// be thrown if an invalid file descriptor is expected.
 	if(fd == -1) report(errno);
 
+	// Learn about the size of regular file, so that reaching end of
+	// file could be told without an extra read returning nothing.
+	struct stat st;
+	if(fstat(fd, &st) < 0) report(errno);
+	if(S_ISREG(st.st_mode)) filesize = st.st_size;
+
 	// Use posix_fadvise() to make it more friendly for sequential read.
 	if(posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) < 0) report(errno);
 
@@ -62,11 +74,14 @@ void SequentialFileBase::read(char* buf, size_t size) throw (wdedup::Error) {
 	while(size > 0) {
 		// Read more data into the buffer if empty buffer.
 		if(readoff == readlen) {
-			ssize_t nextreadlen = ::read(fd, readbuf, bufsiz);
+			ssize_t nextreadlen = ::read(fd, readbuf.get(), bufsize);
+			statsAdd(&StatsCounters::readCalls, 1);
 			if(nextreadlen == -1) report(errno);
 			else if(nextreadlen == 0) report(EIO); // premature EOF.
 			readoff = 0; filetell += readlen;
 			readlen = (size_t)nextreadlen;
+			statsAdd(&StatsCounters::bytesRead, readlen);
+			WDEDUP_PROBE3(file__refill, fd, filetell, readlen);
 		}
 
 		// Fill the file with remainder content of buffer.
@@ -82,11 +97,15 @@ void SequentialFileBase::read(char* buf, size_t size) throw (wdedup::Error) {
 
 bool SequentialFileBase::checkeof() noexcept {
 	if(readoff != readlen) return false;
-	ssize_t nextreadlen = ::read(fd, readbuf, bufsiz);
+	if(filetell + readlen >= filesize) return true;
+	ssize_t nextreadlen = ::read(fd, readbuf.get(), bufsize);
+	statsAdd(&StatsCounters::readCalls, 1);
 	// As error will be detected in proceeding read, ignore.
 	if(nextreadlen < 0) return false;
 	else if(nextreadlen == 0) return true;
+	statsAdd(&StatsCounters::bytesRead, nextreadlen);
 	readoff = 0; filetell += readlen; readlen = (size_t)nextreadlen;
+	WDEDUP_PROBE3(file__refill, fd, filetell, readlen);
 	return false;
 }
 
@@ -125,7 +144,9 @@ AppendFileBase::~AppendFileBase() noexcept {
 }
 
 void AppendFileBase::write(const char* buf, size_t size) throw (wdedup::Error) {
+	statsAdd(&StatsCounters::writeCalls, 1);
 	if(::write(fd, buf, size) == -1) report(errno);
+	statsAdd(&StatsCounters::bytesWritten, size);
 }
 
 AppendFileLog::AppendFileLog(
@@ -141,9 +162,15 @@ void AppendFileLog::write(const char* buf, size_t size) throw (wdedup::Error) {
 
 void AppendFileLog::sync() throw (wdedup::Error) {
 	size_t writebufsiz = writebuf.size();
+	WDEDUP_PROBE1(log__sync__start, writebufsiz);
 	AppendFileBase::write(writebuf.data(), writebufsiz);
 	{ std::vector<char> empty; writebuf.swap(empty); }
-	if(fsync(fd) == -1) report(errno);
+	statsAdd(&StatsCounters::syncCalls, 1);
+	{
+		wdedup::TraceSpan span("fsync", writebufsiz);
+		if(fsync(fd) == -1) report(errno);
+	}
+	WDEDUP_PROBE1(log__sync__end, writebufsiz);
 
 	// We use actual size here, as logs without synchronization will never be
 	// written out as is assumed.
@@ -151,21 +178,22 @@ void AppendFileLog::sync() throw (wdedup::Error) {
 }
 
 AppendFileBuffer::AppendFileBuffer(
-	const char* path, std::function<void(int)> report
-) throw (wdedup::Error): AppendFileBase(path, report), writelen(0) {
+	const char* path, std::function<void(int)> report, size_t bufsize
+) throw (wdedup::Error): AppendFileBase(path, report), 
+	bufsize(bufsize), writebuf(new char[bufsize]), writelen(0) {
 }
 
 void AppendFileBuffer::write(const char* buf, size_t insize) throw (wdedup::Error) {
 	size_t size = insize;
 	while(size > 0) {
 		// Flushes the previous buffer.
-		if(writelen == bufsiz) {
-			AppendFileBase::write(writebuf, bufsiz);
+		if(writelen == bufsize) {
+			AppendFileBase::write(writebuf.get(), bufsize);
 			writelen = 0;
 		}
 
 		// Fill content of curent data to buffer.
-		size_t currentsiz = std::min(bufsiz - writelen, size);
+		size_t currentsiz = std::min(bufsize - writelen, size);
 		memcpy(&writebuf[writelen], buf, currentsiz);
 		buf += currentsiz; size -= currentsiz; writelen += currentsiz;
 	}
@@ -174,7 +202,7 @@ void AppendFileBuffer::write(const char* buf, size_t insize) throw (wdedup::Erro
 
 void AppendFileBuffer::sync() throw (wdedup::Error) {
 	if(writelen > 0) {
-		AppendFileBase::write(writebuf, writelen);
+		AppendFileBase::write(writebuf.get(), writelen);
 		writelen = 0;
 	}
 }
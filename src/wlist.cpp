@@ -0,0 +1,348 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wlist.cpp
+ * @author Haoran Luo
+ * @brief wdedup List-All Implementation
+ *
+ * This file implements the listing function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wmpdp.hpp"
+#include "impl/wwmman.hpp"
+#include "impl/wpool.hpp"
+#include "impl/wbudget.hpp"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+
+namespace wdedup {
+
+/**
+ * @brief Indicates the type of current log item.
+ *
+ * Giving wlist log items type makes it easier to determine the
+ * boundary of stage from the perspective of logging.
+ */
+enum class WListLog : char {
+	/**
+	 * @brief Indicates the beginning of wlist stage.
+	 *
+	 * The id of the profile to list will be followed.
+	 */
+	begin = 'l',
+
+	/**
+	 * @brief Records a successfully sorted run.
+	 *
+	 * The log should be of format
+	 * ```c++
+	 * struct {
+	 *     size_t block, item, size;
+	 * };
+	 * ```
+	 * where the run ends before the item-th item of the block, and
+	 * starts from where the previous run ends.
+	 */
+	run = 'r',
+
+	/**
+	 * @brief Records a successfully merged run.
+	 *
+	 * A payload of execution plan will be followed.
+	 */
+	merge = 'o',
+
+	/// Indicates the ending of wlist stage.
+	end = 'z'
+};
+
+/// Retrieve the name of the sorted run under the workdir.
+static inline std::string runName(size_t id) {
+	return "occur." + std::to_string(id);
+}
+
+/// The item of sorted run allocated in the working memory.
+struct ListRunItem {
+	/// The first occurence of the word.
+	fileoff_t occur;
+
+	/// The word allocated in the pool end.
+	const char* word;
+
+	/// Indicate this item is less than the next one.
+	bool operator<(const ListRunItem& that) const noexcept {
+		return occur < that.occur;
+	}
+};
+
+/// Sort the items collected in the working memory slice and write 
+/// them out as a sorted run.
+static size_t wlistRun(wdedup::Config& cfg, size_t id,
+	wdedup::MemoryManager<ListRunItem>& wmman) throw (wdedup::Error) {
+	std::sort(wmman.begin(), wmman.end());
+	cfg.remove(runName(id));
+	std::unique_ptr<wdedup::ProfileOutput> output = 
+		cfg.openOutput(runName(id));
+	for(ListRunItem* it = wmman.begin(); it != wmman.end(); ++ it)
+		output->push(ProfileItem(std::string(it->word), it->occur));
+	return output->close();
+}
+
+void wlist(wdedup::Config& cfg, size_t root, std::ostream& out,
+	size_t threads, bool disableGC) throw (wdedup::Error) {
+	std::string path = std::to_string(root);
+
+	// The block index is outside the working memory, see ioShare().
+	std::vector<wdedup::ProfileBlock> blocks = cfg.openIndex(path);
+	std::vector<wdedup::ProfileSegment> runs;
+	size_t block = 0, item = 0;
+	wdedup::MergePlan plan;
+	bool merged = false;
+	std::unique_ptr<wdedup::MergePlannerDP> planner;
+
+	// Attempt to recover the sorted runs and merged runs.
+	bool begun = false;
+	if(!cfg.hasRecoveryDone()) while(!(cfg.ilog().eof())) {
+		// Parse the current line of log.
+		char type; cfg.ilog() >> type;
+		switch(type) {
+		case (char)wdedup::WListLog::begin: {
+			// The listed profile must be the current root.
+			size_t listed; cfg.ilog() >> listed;
+			if(begun || listed != root) cfg.logCorrupt();
+			begun = true;
+		} break;
+		case (char)wdedup::WListLog::run: {
+			// Parse the run parameters.
+			size_t endBlock, endItem, size;
+			cfg.ilog() >> endBlock >> endItem >> size;
+			if(!begun || planner != nullptr) cfg.logCorrupt();
+			if(endBlock < block || (endBlock == block && endItem < item))
+				cfg.logCorrupt();
+			if(endBlock > blocks.size() || (endBlock == blocks.size() 
+				&& endItem > 0)) cfg.logCorrupt();
+
+			// Place the runs out.
+			wdedup::ProfileSegment run;
+			run.id = runs.size();
+			run.start = block;
+			run.end = endBlock;
+			run.size = size;
+			runs.push_back(run);
+			block = endBlock; item = endItem;
+		} break;
+		case (char)wdedup::WListLog::merge: {
+			// Parse the segment parameters.
+			size_t left, right, id, size;
+			cfg.ilog() >> left >> right >> id >> size;
+			if(block != blocks.size()) cfg.logCorrupt();
+			if(planner == nullptr) planner.reset(
+				new wdedup::MergePlannerDP(cfg, runs));
+
+			// If the logged item does not match the 
+			// working items, report errors.
+			if(!planner->pop(plan)) cfg.logCorrupt();
+			if(plan.left != left || plan.right != right ||
+				plan.id != id) cfg.logCorrupt();
+
+			// Garbage collect merged runs.
+			if(!disableGC) {
+				cfg.remove(runName(left));
+				cfg.remove(runName(right));
+			}
+		} break;
+		case (char)wdedup::WListLog::end: {
+			if(block != blocks.size()) cfg.logCorrupt();
+			if(runs.size() > 0) {
+				if(planner == nullptr) planner.reset(
+					new wdedup::MergePlannerDP(cfg, runs));
+				if(planner->pop(plan)) cfg.logCorrupt();
+			}
+			merged = true;
+		} break;
+		default:
+			// Report corruption for unknown log item type.
+			cfg.logCorrupt();
+		}
+		if(merged) break;
+	}
+
+	if(!merged) {
+		// Recovery should be ended in current stage, we must work and
+		// produces loggings from current point and in later stages.
+		cfg.recoveryDone();
+		if(!begun) cfg.olog() << wdedup::WListLog::begin 
+			<< root << wdedup::sync;
+
+		// Divide the working memory into slices leased from the budget.
+		// While the items are read into a slice, the previous slices 
+		// are sorted and written out as runs by other threads.
+		if(threads == 0) threads = 1;
+		size_t slice = cfg.budget().size() / threads;
+		slice -= slice % wdedup::MemoryBudget::alignment;
+		struct RunTask {
+			wdedup::MemoryLease lease;
+			std::unique_ptr<wdedup::MemoryManager<ListRunItem>> wmman;
+			size_t block, item, size;
+			std::unique_ptr<wdedup::TaskGroup> worker;
+		};
+		std::vector<RunTask> tasks(threads);
+
+		// Wait for the run to complete and write out the log.
+		auto complete = [&](RunTask& task) {
+			if(task.wmman == nullptr) return;
+			std::exception_ptr error;
+			try { task.worker->wait(); } 
+			catch(...) { error = std::current_exception(); }
+			task.worker = nullptr;
+			task.wmman = nullptr;
+			task.lease = wdedup::MemoryLease();
+			if(error) std::rethrow_exception(error);
+			cfg.olog() << wdedup::WListLog::run << task.block
+				<< task.item << task.size << wdedup::sync;
+
+			wdedup::ProfileSegment run;
+			run.id = runs.size();
+			run.start = runs.size() == 0? 0 : runs.back().end;
+			run.end = task.block;
+			run.size = task.size;
+			runs.push_back(run);
+		};
+
+		// Reposition the input at the recovered position.
+		std::unique_ptr<wdedup::ProfileInput> input;
+		if(block < blocks.size()) {
+			input = cfg.openInput(path, blocks[block]);
+			for(size_t i = 0; i < item && !input->empty(); ++ i) 
+				input->pop();
+		}
+
+		// Generate the sorted runs, the slices are used in turn.
+		size_t id = runs.size(), k = 0;
+		try {
+			for(; block < blocks.size(); ++ k) {
+				RunTask& task = tasks[k % threads];
+				complete(task);
+				task.lease = cfg.budget().acquire(slice);
+				task.wmman.reset(new wdedup::MemoryManager<ListRunItem>(
+					task.lease.data(), task.lease.size()));
+
+				// Collect the singular items until the slice is full.
+				bool full = false;
+				while(!full && block < blocks.size()) {
+					// Skip the blocks without singular items.
+					if(item == 0 && blocks[block].minOccur 
+						== ProfileBlock::none) {
+						input = nullptr;
+						++ block;
+						continue;
+					}
+					if(input == nullptr) 
+						input = cfg.openInput(path, blocks[block]);
+
+					for(; item < blocks[block].items && 
+						!input->empty(); ++ item) {
+						const wdedup::ProfileItem& head = input->peek();
+						if(!head.repeated) {
+							// Allocate the item with its word in the pool.
+							ListRunItem* newitem = nullptr;
+							char* newpool = nullptr;
+							size_t allocpool = head.word.size() + 1;
+							if(!task.wmman->alloc(allocpool, 
+								newitem, newpool)) { full = true; break; }
+							memcpy(newpool, head.word.c_str(), allocpool);
+							newitem->occur = head.occur;
+							newitem->word = newpool;
+						}
+						input->pop();
+					}
+					if(!full) { ++ block; item = 0; }
+				}
+				if(full && task.wmman->size() == 0)
+					throw std::logic_error("Insufficient working memory.");
+
+				// Sort and write out the run by the thread pool.
+				task.block = block; task.item = item;
+				task.worker.reset(new wdedup::TaskGroup(cfg.pool()));
+				task.worker->run([&cfg, &task, id]() {
+					task.size = wlistRun(cfg, id, *task.wmman); 
+				});
+				++ id;
+			}
+
+			// Complete the remaining runs in order.
+			for(size_t i = 0; i < threads; ++ i) 
+				complete(tasks[(k + i) % threads]);
+		} catch(...) {
+			// Wait for the remaining runs before leaving.
+			for(size_t i = 0; i < threads; ++ i) tasks[i].worker = nullptr;
+			throw;
+		}
+
+		// Perform iterative merging on the sorted runs.
+		if(runs.size() > 0 && planner == nullptr) planner.reset(
+			new wdedup::MergePlannerDP(cfg, runs));
+		while(planner != nullptr && planner->pop(plan)) {
+			std::unique_ptr<wdedup::ProfileInput> left =
+				cfg.openInput(runName(plan.left));
+			std::unique_ptr<wdedup::ProfileInput> right =
+				cfg.openInput(runName(plan.right));
+			cfg.remove(runName(plan.id));
+			std::unique_ptr<wdedup::ProfileOutput> output =
+				cfg.openOutput(runName(plan.id));
+
+			// Remove the earlier one to the output run.
+			while((!left->empty()) && (!right->empty())) {
+				if(left->peek().occur < right->peek().occur)
+					output->push(left->pop());
+				else output->push(right->pop());
+			}
+			while(!left->empty()) output->push(left->pop());
+			while(!right->empty()) output->push(right->pop());
+			size_t size = output->close();
+
+			// Write out the persistent finished log.
+			cfg.olog() << wdedup::WListLog::merge 
+				<< plan.left << plan.right << plan.id 
+				<< size << wdedup::sync;
+
+			// Perform garbage collection.
+			if(!disableGC) {
+				cfg.remove(runName(plan.left));
+				cfg.remove(runName(plan.right));
+			}
+		}
+		cfg.olog() << wdedup::WListLog::end << wdedup::sync;
+	}
+
+	// Print out the words of the final sorted run.
+	if(runs.size() == 0) return;
+	std::unique_ptr<wdedup::ProfileInput> sorted = 
+		cfg.openInput(runName(plan.id));
+	while(!sorted->empty()) out << sorted->pop().word << '\n';
+	out.flush();
+}
+
+} // namespace wdedup
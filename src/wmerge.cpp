@@ -28,8 +28,15 @@
  * for more definition details.
  */
 #include "wdedup.hpp"
+#include "impl/wstats.hpp"
+#include "impl/wprogress.hpp"
+#include "impl/wtrace.hpp"
+#include "impl/wprobe.hpp"
+#include "impl/wpool.hpp"
+#include <map>
 #include <queue>
 #include <cassert>
+#include <vector>
 
 namespace wdedup {
 
@@ -79,6 +86,7 @@ size_t wmerge(
 			if(plan.left != left) cfg.logCorrupt();
 			if(plan.right != right) cfg.logCorrupt();
 			if(plan.id != out) cfg.logCorrupt();
+			cfg.progress().merged(plan);
 
 			// Garbage collect merged nodes.
 			if(!disableGC) {
@@ -103,12 +111,29 @@ size_t wmerge(
 	// produces loggings from current point and in later stages.
 	cfg.recoveryDone();
 
-	// Perform iterative merging on the generated profiles.
-	while(planner.pop(plan)) {
+	// Collect the remaining plans, so that the merges whose inputs are
+	// ready can be performed by the thread pool while earlier merges
+	// are still running. The planners in this tree generate all plans
+	// ahead, so no plan depends on the merged segments pushed back.
+	std::vector<wdedup::MergePlan> plans;
+	while(planner.pop(plan)) plans.push_back(plan);
+	std::map<size_t, size_t> producer;
+	for(size_t i = 0; i < plans.size(); ++ i) producer[plans[i].id] = i;
+
+	// Perform the merge of two profiles into the output profile.
+	auto perform = [&cfg](const wdedup::MergePlan& plan) -> size_t {
+		wdedup::TraceSpan span("merge", plan.id);
+		WDEDUP_PROBE3(merge__start, plan.id, plan.left, plan.right);
+		wdedup::StatsReport::Scope scope(cfg.stats(), 
+			std::to_string(plan.id), wdedup::StatsKind::merge);
+		scope.extra("left", plan.left);
+		scope.extra("right", plan.right);
+		scope.extra("plannedCost", plan.cost);
 		std::unique_ptr<wdedup::ProfileInput> left =
 			cfg.openInput(std::to_string(plan.left));
 		std::unique_ptr<wdedup::ProfileInput> right =
 			cfg.openInput(std::to_string(plan.right));
+		cfg.remove(std::to_string(plan.id));
 		std::unique_ptr<wdedup::ProfileOutput> out =
 			cfg.openOutput(std::to_string(plan.id));
 
@@ -120,9 +145,13 @@ size_t wmerge(
 			else if(left->peek().word > right->peek().word)
 				out->push(std::move(right->pop()));
 
-			// Merge the same profile items into repeated item.
+			// Merge the same profile items into repeated item, whose
+			// number of occurences is recorded only if both are.
 			else {
-				out->push(ProfileItem(left->peek().word));
+				ProfileItem item(left->peek().word);
+				if(left->peek().count > 0 && right->peek().count > 0)
+					item.count = left->peek().count + right->peek().count;
+				out->push(std::move(item));
 				left->pop(); right->pop();
 			}
 		}
@@ -131,12 +160,42 @@ size_t wmerge(
 		while(!left->empty()) out->push(std::move(left->pop()));
 		while(!right->empty()) out->push(std::move(right->pop()));
 		size_t size = out->close();
-
-		// Write out the persistent finished log.
+		WDEDUP_PROBE2(merge__end, plan.id, size);
+		return size;
+	};
+
+	// The merges running on the thread pool, at most one per worker.
+	struct MergeTask {
+		size_t size;
+		std::unique_ptr<wdedup::TaskGroup> worker;
+	};
+	std::vector<MergeTask> tasks(plans.size());
+	size_t threads = cfg.pool().size();
+	size_t committed = 0, running = 0;
+
+	// A plan is ready when the merges producing its inputs have been 
+	// committed, the leaf segments and recovered nodes always are.
+	auto ready = [&](size_t i) -> bool {
+		for(size_t input : { plans[i].left, plans[i].right }) {
+			auto found = producer.find(input);
+			if(found != producer.end() && found->second >= committed)
+				return false;
+		}
+		return true;
+	};
+
+	// Wait for the merge to complete and write out the log in the 
+	// order of plans, so that recovery matches them in pop order.
+	auto complete = [&](size_t i) {
+		tasks[i].worker->wait();
+		tasks[i].worker = nullptr;
+		-- running; ++ committed;
+		const wdedup::MergePlan& plan = plans[i];
 		cfg.olog() << wdedup::WMergeLog::merge 
 			<< plan.left << plan.right << plan.id 
-			<< size << wdedup::sync;
-		
+			<< tasks[i].size << wdedup::sync;
+		cfg.progress().merged(plan);
+
 		// Perform garbage collection.
 		if(!disableGC) {
 			cfg.remove(std::to_string(plan.left));
@@ -146,8 +205,30 @@ size_t wmerge(
 		// Place back the merged node.
 		wdedup::MergeSegment merged;
 		merged.plan = plan;
-		merged.size = size;
+		merged.size = tasks[i].size;
 		planner.push(merged);
+	};
+
+	// Perform iterative merging on the generated profiles.
+	try {
+		while(committed < plans.size()) {
+			for(size_t i = committed; i < plans.size() 
+				&& running < threads; ++ i) {
+				if(tasks[i].worker != nullptr || !ready(i)) continue;
+				MergeTask& task = tasks[i];
+				const wdedup::MergePlan& current = plans[i];
+				task.worker.reset(new wdedup::TaskGroup(cfg.pool()));
+				task.worker->run([&perform, &task, &current]() {
+					task.size = perform(current); 
+				});
+				++ running;
+			}
+			complete(committed);
+		}
+	} catch(...) {
+		// Wait for the remaining merges before leaving.
+		for(size_t i = 0; i < tasks.size(); ++ i) tasks[i].worker = nullptr;
+		throw;
 	}
 
 	// Return the single node of current layer.
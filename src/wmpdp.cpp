@@ -29,6 +29,7 @@
  */
 #include "wdedup.hpp"
 #include "impl/wmpdp.hpp"
+#include "impl/wtrace.hpp"
 #include <queue>
 #include <cassert>
 
@@ -36,6 +37,7 @@ namespace wdedup {
 
 MergePlannerDP::MergePlannerDP(wdedup::Config& config,
 	std::vector<ProfileSegment> segment): plans(), cursor(0) {
+	wdedup::TraceSpan span("plan", segment.size());
 	
 	// Eliminate root cases.
 	if(segment.size() == 0) config.logCorrupt();
@@ -133,6 +135,7 @@ MergePlannerDP::MergePlannerDP(wdedup::Config& config,
 		plan.left = left.id - 1;
 		plan.right = right.id - 1;
 		plan.id = item.id - 1;
+		plan.cost = (left.length + right.length) * 2;
 		plans.push_back(plan);
 	}
 
@@ -95,6 +95,7 @@ MergePlannerSimple::MergePlannerSimple(wdedup::Config& config,
 		plan.left = left - 1;
 		plan.right = right - 1;
 		plan.id = put;
+		plan.cost = 0;
 		plans.push_back(plan);
 		nodes.push(put + 1); ++ put;
 	}
@@ -0,0 +1,181 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wperf.cpp
+ * @author Haoran Luo
+ * @brief wdedup Hardware Performance Counters Implementation
+ *
+ * This file implements the hardware performance counters, see the 
+ * header file for more definition details.
+ */
+#include "impl/wperf.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace wdedup {
+
+PerfSample PerfSample::operator-(const PerfSample& s) const noexcept {
+	PerfSample d;
+	for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i) {
+		d.counted[i] = counted[i] && s.counted[i];
+		d.values[i] = values[i] - s.values[i];
+	}
+	return d;
+}
+
+const char* PerfCounters::name(PerfEvent event) noexcept {
+	static const char* names[] = { "cycles", "instructions", 
+		"cacheMisses", "dtlbMisses", "branchMisses" };
+	return names[(size_t)event];
+}
+
+// Open the counter of the event on the thread, inside the group.
+static int openEvent(PerfEvent event, pid_t tid, int group) noexcept {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	switch(event) {
+	case PerfEvent::cycles: 
+		attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+	case PerfEvent::instructions: 
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+	case PerfEvent::cacheMisses: 
+		attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+	case PerfEvent::dtlbMisses:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | 
+			(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	default:
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+	}
+	attr.read_format = PERF_FORMAT_GROUP | 
+		PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// Only the user space is counted, which is permitted for the own
+	// process unless perf_event_paranoid is greater than 2.
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &attr, tid, -1, 
+		group, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Retrieve the threads currently in the process.
+static std::vector<pid_t> threads() noexcept {
+	std::vector<pid_t> result;
+	DIR* dir = opendir("/proc/self/task");
+	if(dir == nullptr) return result;
+	while(struct dirent* entry = readdir(dir))
+		if(entry->d_name[0] != '.') result.push_back(atoi(entry->d_name));
+	closedir(dir);
+	return result;
+}
+
+PerfCounters::PerfCounters() noexcept: groups(), tids(), events(), reason() {
+	try {
+		std::vector<pid_t> listed = threads();
+		if(listed.empty()) { reason = "threads are not listed"; return; }
+
+		// Find out the events that could be opened on the first thread,
+		// and the reason why the first event failed if none could.
+		int failure = 0;
+		std::vector<int> group;
+		for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i) {
+			int fd = openEvent((PerfEvent)i, listed[0], 
+				group.empty()? -1 : group[0]);
+			if(fd < 0) { if(failure == 0) failure = errno; continue; }
+			group.push_back(fd);
+			events.push_back((PerfEvent)i);
+		}
+		if(group.empty()) {
+			reason = strerror(failure);
+			if(failure == EACCES || failure == EPERM) {
+				std::ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+				std::string level; paranoid >> level;
+				if(!level.empty()) reason += 
+					" (perf_event_paranoid is " + level + ")";
+			}
+			events.clear();
+			return;
+		}
+		groups.push_back(group);
+		tids.push_back(listed[0]);
+
+		// Open the same events on other threads, the threads exited
+		// meanwhile are skipped.
+		for(size_t t = 1; t < listed.size(); ++ t) {
+			group.clear();
+			for(size_t i = 0; i < events.size(); ++ i) {
+				int fd = openEvent(events[i], listed[t], 
+					group.empty()? -1 : group[0]);
+				if(fd < 0) break;
+				group.push_back(fd);
+			}
+			if(group.size() == events.size()) {
+				groups.push_back(group);
+				tids.push_back(listed[t]);
+			} else for(size_t i = 0; i < group.size(); ++ i) close(group[i]);
+		}
+	} catch(...) {
+		reason = "out of memory";
+	}
+}
+
+PerfCounters::~PerfCounters() noexcept {
+	for(size_t g = 0; g < groups.size(); ++ g)
+		for(size_t i = 0; i < groups[g].size(); ++ i) close(groups[g][i]);
+}
+
+PerfSample PerfCounters::sample(bool thread) const noexcept {
+	PerfSample s;
+	for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i) {
+		s.values[i] = 0.0;
+		s.counted[i] = false;
+	}
+	for(size_t i = 0; i < events.size(); ++ i) 
+		s.counted[(size_t)events[i]] = true;
+
+	// The group is read as its number of members, the time enabled
+	// and running, followed by the value of each member.
+	uint64_t buffer[3 + (size_t)PerfEvent::count];
+	int self = thread? (int)syscall(SYS_gettid) : 0;
+	for(size_t g = 0; g < groups.size(); ++ g) {
+		if(thread && tids[g] != self) continue;
+		ssize_t size = read(groups[g][0], buffer, sizeof(buffer));
+		if(size < (ssize_t)(3 * sizeof(uint64_t))) continue;
+		if(buffer[0] != events.size() || buffer[2] == 0) continue;
+		double scale = (double)buffer[1] / buffer[2];
+		for(size_t i = 0; i < events.size(); ++ i)
+			s.values[(size_t)events[i]] += buffer[3 + i] * scale;
+	}
+	return s;
+}
+
+} // namespace wdedup
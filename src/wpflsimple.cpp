@@ -27,7 +27,16 @@
  * See corresponding header for interface definitions.
  */
 #include "impl/wpflsimple.hpp"
+#include "impl/wfilter.hpp"
+#include "impl/wstats.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace wdedup {
 
@@ -47,9 +56,15 @@ void ProfileInputSimple::popFill() throw (wdedup::Error) {
 
 		// When the item is repeated, the value will be any non zero
 		// value, otherwise it will be zero followed by an occurance.
-		if(repeated != 0) head.repeated = true;
-		else {
+		// And the counted repeated item is followed by its count.
+		if(repeated != 0) {
+			head.repeated = true;
+			uint64_t count = 0;
+			if(repeated == 2) input >> wdedup::varint(count);
+			head.count = count;
+		} else {
 			head.repeated = false;
+			head.count = 1;
 			input >> head.occur;
 		}
 	}
@@ -62,21 +77,220 @@ const ProfileItem& ProfileInputSimple::peek() const noexcept { return head; }
 wdedup::ProfileItem ProfileInputSimple::pop() throw (wdedup::Error) {
 	wdedup::ProfileItem result(std::move(head));
 	popFill();
+	statsAdd(&StatsCounters::itemsRead, 1);
 	return result;
 }
 
-ProfileOutputSimple::ProfileOutputSimple(std::string path, FileMode mode) 
-	throw (wdedup::Error) : output(path, "profile-simple", mode) {}
+ProfileOutputSimple::ProfileOutputSimple(std::string path, FileMode mode,
+	bool counting, bool indexed) throw (wdedup::Error) : 
+	output(path, "profile-simple", mode), counting(counting) {
+	if(indexed) {
+		index.reset(new wdedup::AppendFile(
+			profileIndexPath(path), "profile-index", mode));
+		filter.reset(new wdedup::AppendFile(
+			profileFilterPath(path), "profile-filter", mode));
+	}
+
+	block.offset = output.tell();
+	block.size = 0;
+	block.items = 0;
+	block.minOccur = ProfileBlock::none;
+	block.maxCount = 1;
+}
+
+void ProfileOutputSimple::flushBlock() throw (wdedup::Error) {
+	if(block.items == 0) return;
+	block.size = output.tell() - block.offset;
+	if(index != nullptr) {
+		*index << block.offset << block.size << block.items 
+			<< block.minOccur << block.maxCount << block.first;
+
+		// Build and write out the bloom filter of the block.
+		std::vector<unsigned char> bits(filterSize(block.items), 0);
+		for(size_t i = 0; i < hashes.size(); ++ i)
+			filterAdd(bits.data(), bits.size(), hashes[i]);
+		filter->write((const char*)bits.data(), bits.size());
+	}
+
+	// Start a new block from current position.
+	block.offset = output.tell();
+	block.items = 0;
+	block.minOccur = ProfileBlock::none;
+	block.maxCount = 1;
+	hashes.clear();
+}
 
 void ProfileOutputSimple::push(ProfileItem pi) throw (wdedup::Error) {
+	statsAdd(&StatsCounters::itemsWritten, 1);
+
+	// Start a new block if current block is large enough.
+	if(output.tell() - block.offset >= profileBlockSize) flushBlock();
+
+	// Update the summary of current block.
+	if(block.items == 0) block.first = pi.word;
+	if(filter != nullptr) 
+		hashes.push_back(filterHash(pi.word.c_str(), pi.word.size()));
+	++ block.items;
+	if(!pi.repeated && pi.occur < block.minOccur) 
+		block.minOccur = pi.occur;
+	size_t count = counting? pi.count : 0;
+	if(pi.repeated && count == 0) block.maxCount = 0;
+	else if(block.maxCount > 0 && count > block.maxCount)
+		block.maxCount = count;
+
 	output << pi.word;
-	if(pi.repeated) output << (char)1;
+	if(pi.repeated && count > 0) {
+		uint64_t value = count;
+		output << (char)2 << wdedup::varint(value);
+	}
+	else if(pi.repeated) output << (char)1;
 	else output << (char)0 << pi.occur;
 }
 
 size_t ProfileOutputSimple::close() throw (wdedup::Error) {
+	flushBlock();
+	if(index != nullptr) *index << wdedup::sync;
+	if(filter != nullptr) *filter << wdedup::sync;
 	output << wdedup::sync;
 	return output.tell();
 }
 
+std::vector<wdedup::ProfileBlock> profileIndexSimple(
+	std::string path, wdedup::FileMode mode) throw (wdedup::Error) {
+	wdedup::SequentialFile index(profileIndexPath(path), 
+			"profile-index", mode);
+
+	// Read the block summaries until the end of index.
+	std::vector<wdedup::ProfileBlock> blocks;
+	while(!index.eof()) {
+		wdedup::ProfileBlock block;
+		index >> block.offset >> block.size 
+			>> block.items >> block.minOccur >> block.maxCount 
+			>> block.first;
+		blocks.push_back(std::move(block));
+	}
+	return blocks;
+}
+
+void profileRemoveSimple(const std::string& path) noexcept {
+	unlink(path.c_str());
+	unlink(profileIndexPath(path).c_str());
+	unlink(profileFilterPath(path).c_str());
+}
+
+// Map the whole file read-only, returning nullptr for empty file.
+static const char* mapFile(const std::string& path, 
+		const char* role, size_t& size) throw (wdedup::Error) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw wdedup::Error(errno, path, role);
+	struct stat st; if(fstat(fd, &st) < 0) {
+		int eno = errno; close(fd);
+		throw wdedup::Error(eno, path, role);
+	}
+	size = st.st_size;
+	if(size == 0) { close(fd); return nullptr; }
+	void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	int eno = errno; close(fd);
+	if(addr == MAP_FAILED) throw wdedup::Error(eno, path, role);
+
+	// Lookups visit the blocks randomly, disable readahead.
+	madvise(addr, size, MADV_RANDOM);
+	return (const char*)addr;
+}
+
+ProfileLookupSimple::ProfileLookupSimple(std::string path, FileMode mode)
+	throw (wdedup::Error): path(path), blocks(profileIndexSimple(path, mode)),
+	filters(), profile(nullptr), profileSize(0), 
+	filter(nullptr), filterSize(0) {
+
+	// The filters are stored consecutively in the order of blocks.
+	size_t filterOffset = 0;
+	for(size_t i = 0; i < blocks.size(); ++ i) {
+		filters.push_back(filterOffset);
+		filterOffset += wdedup::filterSize(blocks[i].items);
+	}
+
+	try {
+		profile = mapFile(path, "profile-simple", profileSize);
+		filter = (const unsigned char*)mapFile(
+			profileFilterPath(path), "profile-filter", filterSize);
+	} catch(wdedup::Error&) {
+		if(profile != nullptr) munmap((void*)profile, profileSize);
+		throw;
+	}
+	if(filterSize < filterOffset) {
+		if(profile != nullptr) munmap((void*)profile, profileSize);
+		if(filter != nullptr) munmap((void*)filter, filterSize);
+		throw wdedup::Error(EIO, profileFilterPath(path), "profile-filter");
+	}
+}
+
+ProfileLookupSimple::~ProfileLookupSimple() noexcept {
+	if(profile != nullptr) munmap((void*)profile, profileSize);
+	if(filter != nullptr) munmap((void*)filter, filterSize);
+	profile = nullptr; filter = nullptr;
+}
+
+bool ProfileLookupSimple::find(const std::string& word, 
+		ProfileItem& item) const throw (wdedup::Error) {
+	// Locate the last block whose first word is not greater than
+	// the word, which is the only block that could contain it.
+	auto next = std::upper_bound(blocks.begin(), blocks.end(), word,
+		[](const std::string& w, const wdedup::ProfileBlock& b) {
+			return w < b.first; });
+	if(next == blocks.begin()) return false;
+	size_t i = (next - blocks.begin()) - 1;
+	const wdedup::ProfileBlock& block = blocks[i];
+
+	// Test the filter before touching the block.
+	uint64_t hash = filterHash(word.c_str(), word.size());
+	if(!filterTest(filter + filters[i], 
+		wdedup::filterSize(block.items), hash)) return false;
+
+	// Scan the items of the block, which are sorted by words.
+	if(block.offset + block.size > profileSize) 
+		throw wdedup::Error(EIO, path, "profile-simple");
+	const char* current = profile + block.offset;
+	const char* end = current + block.size;
+	while(current < end) {
+		const char* terminator = (const char*)memchr(
+			current, 0, end - current);
+		if(terminator == nullptr || terminator + 1 >= end)
+			throw wdedup::Error(EIO, path, "profile-simple");
+		const char* record = current;
+		size_t length = terminator - current;
+		current = terminator + 1;
+
+		// Parse the repeated flag and the occurence or count.
+		char flag = *current ++;
+		bool repeated = flag != 0;
+		fileoff_t occur = 0; size_t count = repeated? 0 : 1;
+		if(!repeated) {
+			if(current + sizeof(occur) > end)
+				throw wdedup::Error(EIO, path, "profile-simple");
+			memcpy(&occur, current, sizeof(occur));
+			current += sizeof(occur);
+		} else if(flag == 2) {
+			for(size_t shift = 0; ; shift += 7) {
+				if(current >= end) 
+					throw wdedup::Error(EIO, path, "profile-simple");
+				unsigned char c = (unsigned char)(*current ++);
+				count |= (size_t)(c & 0x7f) << shift;
+				if(!(c & 0x80)) break;
+			}
+		}
+
+		// Compare the word, stop once we have passed it.
+		int cmp = word.compare(0, std::string::npos, record, length);
+		if(cmp > 0) continue;
+		if(cmp < 0) return false;
+		item.word = word;
+		item.repeated = repeated;
+		item.occur = occur;
+		item.count = count;
+		return true;
+	}
+	return false;
+}
+
 } // namespace wdedup
@@ -0,0 +1,184 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wpool.cpp
+ * @author Haoran Luo
+ * @brief wdedup Work-Stealing Thread Pool Implementation
+ *
+ * This file implements the work-stealing thread pool, see the header
+ * file for more definition details.
+ */
+#include "impl/wpool.hpp"
+#include <chrono>
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+
+namespace wdedup {
+
+/// The pool and the worker index of current thread.
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::ThreadPool(size_t threads, bool affinity) throw (wdedup::Error):
+	workers(), pending(0), next(0), stopping(false) {
+	if(threads == 0) threads = 1;
+	for(size_t i = 0; i < threads; ++ i) 
+		workers.push_back(std::unique_ptr<Worker>(new Worker));
+
+	// Collect the processors available to the process.
+	std::vector<int> cpus;
+	if(affinity) {
+		cpu_set_t available; CPU_ZERO(&available);
+		if(sched_getaffinity(0, sizeof(available), &available) != 0)
+			throw wdedup::Error(errno, "", "affinity");
+		for(int i = 0; i < CPU_SETSIZE; ++ i)
+			if(CPU_ISSET(i, &available)) cpus.push_back(i);
+	}
+	auto pin = [&](pthread_t thread, size_t worker) {
+		if(cpus.size() == 0) return;
+		cpu_set_t set; CPU_ZERO(&set);
+		CPU_SET(cpus[worker % cpus.size()], &set);
+		int eno = pthread_setaffinity_np(thread, sizeof(set), &set);
+		if(eno != 0) throw wdedup::Error(eno, "", "affinity");
+	};
+
+	// The constructing thread is the first worker.
+	currentPool = this; currentWorker = 0;
+	try {
+		pin(pthread_self(), 0);
+		for(size_t i = 1; i < threads; ++ i) {
+			workers[i]->thread = std::thread(&ThreadPool::loop, this, i);
+			pin(workers[i]->thread.native_handle(), i);
+		}
+	} catch(...) {
+		stop();
+		throw;
+	}
+}
+
+ThreadPool::~ThreadPool() noexcept { stop(); }
+
+void ThreadPool::stop() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		stopping = true;
+	}
+	idle.notify_all();
+	for(size_t i = 0; i < workers.size(); ++ i)
+		if(workers[i]->thread.joinable()) workers[i]->thread.join();
+	if(currentPool == this) currentPool = nullptr;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	// Tasks submitted from outside are spreaded among workers.
+	size_t target = currentPool == this? currentWorker :
+		next.fetch_add(1) % workers.size();
+
+	// The task is counted before it is published, otherwise it might
+	// be taken and discounted by another worker before it is counted.
+	pending.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(workers[target]->mutex);
+		workers[target]->tasks.push_back(std::move(task));
+	}
+
+	// Wake up an idle worker, the pending count is checked with the
+	// idle mutex held, so the wake up will not be lost.
+	{ std::lock_guard<std::mutex> lock(idleMutex); }
+	idle.notify_one();
+}
+
+bool ThreadPool::runOne() noexcept {
+	size_t self = currentPool == this? currentWorker : 0;
+	std::function<void()> task;
+	for(size_t i = 0; i < workers.size() && !task; ++ i) {
+		Worker& worker = *workers[(self + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if(worker.tasks.empty()) continue;
+
+		// Take the latest task of its own, or steal the earliest.
+		if(i == 0) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		} else {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+		}
+	}
+	if(!task) return false;
+	pending.fetch_sub(1);
+	task();
+	return true;
+}
+
+void ThreadPool::loop(size_t self) noexcept {
+	currentPool = this; currentWorker = self;
+	while(true) {
+		if(runOne()) continue;
+		std::unique_lock<std::mutex> lock(idleMutex);
+		idle.wait(lock, [&]() { return stopping || pending.load() > 0; });
+		if(stopping) return;
+	}
+}
+
+void TaskGroup::run(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++ remaining;
+	}
+	pool.submit([this, task]() {
+		std::exception_ptr raised;
+		try { task(); } catch(...) { raised = std::current_exception(); }
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(raised && !error) error = raised;
+		if(-- remaining == 0) done.notify_all();
+	});
+}
+
+void TaskGroup::join() noexcept {
+	while(true) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(remaining == 0) return;
+		}
+
+		// Help running the tasks while the group is not completed, and
+		// check again for stealable tasks after a while.
+		if(pool.runOne()) continue;
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait_for(lock, std::chrono::milliseconds(1),
+			[&]() { return remaining == 0; });
+	}
+}
+
+void TaskGroup::wait() {
+	join();
+	if(error) {
+		std::exception_ptr raised = error;
+		error = nullptr;
+		std::rethrow_exception(raised);
+	}
+}
+
+} // namespace wdedup
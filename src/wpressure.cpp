@@ -0,0 +1,123 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wpressure.cpp
+ * @author Haoran Luo
+ * @brief wdedup Memory Pressure Governor Implementation
+ *
+ * This file implements the memory pressure governor, see the header
+ * file for more definition details.
+ */
+#include "impl/wpressure.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace wdedup {
+
+// Read the first line of the specified file, empty if absent.
+static std::string readLine(const std::string& path) {
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+MemoryGovernorCgroup::MemoryGovernorCgroup(size_t minimum, 
+	std::ostream* report, std::string cgroup) noexcept: 
+	cgroup(), minimum(minimum), report(report) {
+	try {
+		// Look up the cgroup v2 path of the process, which is the 
+		// entry with hierarchy 0 in /proc/self/cgroup.
+		if(cgroup.empty()) {
+			std::ifstream self("/proc/self/cgroup");
+			std::string line, path;
+			while(std::getline(self, line))
+				if(line.compare(0, 3, "0::") == 0) path = line.substr(3);
+			if(path.empty()) return;
+
+			// The v2 hierarchy is mounted either on /sys/fs/cgroup, or
+			// on /sys/fs/cgroup/unified for the hybrid hierarchy.
+			const char* mounts[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+			for(size_t i = 0; i < 2 && cgroup.empty(); ++ i) {
+				std::string candidate = std::string(mounts[i]) + path;
+				if(access((candidate + "/memory.pressure").c_str(), R_OK) == 0)
+					cgroup = candidate;
+			}
+		}
+		if(access((cgroup + "/memory.pressure").c_str(), R_OK) == 0)
+			this->cgroup = cgroup;
+	} catch(...) {
+		this->cgroup.clear();
+	}
+}
+
+size_t MemoryGovernorCgroup::advise(
+	size_t current, size_t capacity) noexcept {
+	if(cgroup.empty()) return current;
+	try {
+		// Parse the "some avg10=..." line of memory.pressure.
+		double pressure = 0.0;
+		std::string some = readLine(cgroup + "/memory.pressure");
+		size_t avg10 = some.find("avg10=");
+		if(avg10 != std::string::npos) 
+			pressure = std::stod(some.substr(avg10 + 6));
+
+		// Parse the memory.high and memory.current, where "max" means
+		// there's no such limit.
+		std::string high = readLine(cgroup + "/memory.high");
+		std::string usage = readLine(cgroup + "/memory.current");
+		bool limited = !high.empty() && high != "max" && !usage.empty();
+		size_t highBytes = limited? std::stoull(high) : 0;
+		size_t usageBytes = limited? std::stoull(usage) : 0;
+
+		// Shrink under pressure or when the usage approaches the limit,
+		// and grow when neither is present with enough headroom.
+		size_t advised = current;
+		if(pressure >= shrinkPressure || 
+			(limited && usageBytes > highBytes / 10 * 9))
+			advised = std::max(minimum, current / 2);
+		else if(pressure < growPressure) {
+			advised = std::min(capacity, current * 2);
+			if(limited && usageBytes + (advised - current) > highBytes / 4 * 3)
+				advised = current;
+		}
+		advised = std::min(std::max(advised, std::min(minimum, capacity)), capacity);
+
+		// Report the decision when the budget is resized.
+		if(advised != current && report != nullptr) {
+			std::stringstream decision;
+			decision << "Working memory: " << current << " -> " << advised 
+				<< " bytes (pressure " << pressure << "%";
+			if(limited) decision << ", usage " << usageBytes 
+				<< " of " << highBytes << " bytes";
+			decision << ")." << std::endl;
+			(*report) << decision.str();
+		}
+		return advised;
+	} catch(...) {
+		return current;
+	}
+}
+
+} // namespace wdedup
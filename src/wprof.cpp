@@ -30,7 +30,17 @@
 #include "wdedup.hpp"
 //#include "impl/wsortdedup.hpp"
 #include "impl/wtreededup.hpp"
+#include "impl/wbudget.hpp"
+#include "impl/wstats.hpp"
+#include "impl/wprogress.hpp"
+#include "impl/wtrace.hpp"
+#include "impl/wprobe.hpp"
+#include "impl/wpool.hpp"
+#include <algorithm>
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -41,11 +51,6 @@ namespace wdedup {
 // Current implementation that is used as deduplicator.
 using Dedup = wdedup::TreeDedup;
 
-// Helper for judging whether a character is whitespace.
-inline bool isWhitespace(char c) {
-	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
-}
-
 /// Performs operations related to the original file.
 struct OriginalFileReader {
 	/// Caching previously read data, if the data is really
@@ -143,6 +148,155 @@ const char* OriginalFileReader::readString(wdedup::SequentialFile& f,
 	}
 }
 
+/// The random table of gear hash, which is generated by splitmix64
+/// so that the chunk boundaries are stable across builds.
+struct GearTable {
+	uint64_t gear[256];
+	GearTable() noexcept {
+		uint64_t seed = 0;
+		for(size_t i = 0; i < 256; ++ i) {
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			gear[i] = z ^ (z >> 31);
+		}
+	}
+};
+
+/// The parameters of content-defined chunking. The boundary of a 
+/// chunk is placed after the first whitespace once the gear hash of 
+/// the content has its top bits cleared, so that the boundaries of 
+/// identical content are identical wherever the content is located.
+struct ChunkParams {
+	/// Minimum size of a chunk before looking for the boundary.
+	size_t minSize;
+
+	/// Maximum size of a chunk before cutting at next whitespace.
+	size_t maxSize;
+
+	/// Number of top bits of gear hash to be cleared.
+	size_t bits;
+
+	/// Derive the parameters from the size of working memory, so
+	/// that a chunk is likely to fit in a single segment. The size
+	/// is bounded so that tasks with sufficient working memory will
+	/// divide identical content into identical chunks.
+	ChunkParams(size_t workmem) noexcept: bits(8) {
+		while(bits < 22 && ((size_t)1 << (bits + 1)) <= workmem / 8) ++ bits;
+		minSize = ((size_t)1 << bits) / 4;
+		maxSize = ((size_t)1 << bits) * 4;
+	}
+};
+
+/// Reads the original file chunk by chunk. The content of current 
+/// chunk is kept in memory, so that the chunk missing in the cache is 
+/// profiled without reading the file again. The content is at most 
+/// the maximum size of the chunk plus its last word, and is outside
+/// the working memory (see ioShare() in impl/wbudget.hpp).
+struct ChunkReader {
+	/// The original file, read from the start of the first chunk.
+	wdedup::SequentialFile file;
+
+	/// The parameters of chunking.
+	ChunkParams params;
+
+	/// The content of current chunk, followed by a '\0'.
+	std::vector<char> content;
+
+	/// The digest of current chunk and its length, as the key.
+	std::string key;
+
+	/// Open the original file at the start of the first chunk.
+	ChunkReader(const std::string& path, fileoff_t start, 
+		ChunkParams params) throw (wdedup::Error): file(path, 
+		"original-file", [=]() { wdedup::FileMode mode; 
+		mode.seekset = start; return mode; }()), params(params) {}
+
+	/// Read the next chunk, returning its length, which is 0 when the 
+	/// end of file has been reached.
+	size_t next() throw (wdedup::Error);
+};
+
+size_t ChunkReader::next() throw (wdedup::Error) {
+	static const GearTable table;
+	content.clear();
+
+	// Feed the content into the gear hash and two lanes of digest.
+	uint64_t gear = 0, h1 = 0xcbf29ce484222325ull, h2 = 0x84222325cbf29ce4ull;
+	size_t length = 0; bool cut = false, done = false;
+	char* bufptr = nullptr; size_t bufsize = 0;
+	while(!done && !file.eof()) {
+		file.bufferptr(bufptr, bufsize);
+		size_t i = 0;
+		while(i < bufsize) {
+			unsigned char c = (unsigned char)bufptr[i ++];
+			gear = (gear << 1) + table.gear[c];
+			h1 = (h1 ^ c) * 0x100000001b3ull;
+			h2 = ((h2 ^ c) * 0xff51afd7ed558ccdull);
+			h2 ^= h2 >> 29;
+			++ length;
+			if(!cut && length >= params.minSize && (length >= params.maxSize
+				|| (gear >> (64 - params.bits)) == 0)) cut = true;
+			if(cut && isWhitespace(c)) { done = true; break; }
+		}
+		content.insert(content.end(), bufptr, bufptr + i);
+		file.bufferskip(i);
+	}
+
+	content.push_back('\0');
+
+	// Format the key with the digest and the length.
+	char digest[64]; snprintf(digest, sizeof(digest), "%016llx%016llx-%llu",
+		(unsigned long long)h1, (unsigned long long)h2, 
+		(unsigned long long)length);
+	key = digest;
+	return length;
+}
+
+/// Insert the words of the content into the engine from specified 
+/// position, with their occurences relative to the content. The 
+/// position of the first word not inserted is returned, which is the 
+/// length of content when every word has been inserted. Each word is
+/// terminated in place while it is inserted, like OriginalFileReader.
+static size_t insertWords(wdedup::Dedup& dedup, 
+	std::vector<char>& content, size_t length, size_t pos) noexcept {
+	while(pos < length) {
+		while(pos < length && isWhitespace(content[pos])) ++ pos;
+		if(pos == length) break;
+		size_t end = pos;
+		while(end < length && !isWhitespace(content[end])) ++ end;
+		char delimiter = content[end]; content[end] = '\0';
+		bool inserted = dedup.insert(&content[pos], end - pos, pos);
+		content[end] = delimiter;
+		if(!inserted) return pos;
+		pos = end;
+	}
+	return length;
+}
+
+/// The profile output adding the start of chunk to the occurences of
+/// the items, which are relative to the chunk.
+class RebasedOutput final : public wdedup::ProfileOutput {
+	/// The delegated profile output.
+	std::unique_ptr<wdedup::ProfileOutput> delegated;
+
+	/// The start of the chunk.
+	fileoff_t base;
+public:
+	RebasedOutput(std::unique_ptr<wdedup::ProfileOutput> delegated, 
+		fileoff_t base) noexcept: delegated(std::move(delegated)), base(base) {}
+
+	virtual void push(wdedup::ProfileItem item) 
+			throw (wdedup::Error) override {
+		if(!item.repeated) item.occur += base;
+		delegated->push(std::move(item));
+	}
+
+	virtual size_t close() throw (wdedup::Error) override {
+		return delegated->close();
+	}
+};
+
 /**
  * @brief Indicates the type of current log item.
  *
@@ -156,9 +310,15 @@ enum class WProfLog : char {
 	 * The log should be of format 
 	 * ```c++
 	 * struct {
-	 *     offset_type start, end;
+	 *     offset_type start, end, size;
+	 *     varint fields;
+	 *     varint occupancy[fields];
 	 * };
 	 * ```
+	 *
+	 * The occupancy fields are in order of wdedup::SegmentOccupancy,
+	 * and the fields unknown to the reader are skipped, so that more
+	 * fields could be appended.
 	 */
 	segment = 's',
 
@@ -166,14 +326,257 @@ enum class WProfLog : char {
 	end = 'e'
 };
 
+/// Write out the occupancy of a segment record.
+static void writeOccupancy(wdedup::AppendFile& log, 
+	wdedup::SegmentOccupancy o) throw (wdedup::Error) {
+	std::vector<uint64_t*> fields = o.fields();
+	uint64_t count = fields.size();
+	log << varint(count);
+	for(size_t i = 0; i < fields.size(); ++ i) log << varint(*fields[i]);
+}
+
+/// Read the occupancy of a segment record.
+static void readOccupancy(wdedup::SequentialFile& log, 
+	wdedup::SegmentOccupancy& o) throw (wdedup::Error) {
+	std::vector<uint64_t*> fields = o.fields();
+	uint64_t count, value; log >> varint(count);
+	for(uint64_t i = 0; i < count; ++ i) {
+		log >> varint(value);
+		if(i < fields.size()) *fields[i] = value;
+	}
+}
+
+/// Write out the record of a persisted segment, and place it out.
+static void logSegment(wdedup::Config& cfg, 
+	std::vector<wdedup::ProfileSegment>& result, size_t id, 
+	fileoff_t start, fileoff_t end, size_t size, 
+	wdedup::SegmentOccupancy occupancy) throw (wdedup::Error) {
+	cfg.olog() << wdedup::WProfLog::segment << start << end << size;
+	writeOccupancy(cfg.olog(), occupancy);
+	cfg.olog() << wdedup::sync;
+	WDEDUP_PROBE4(segment__end, id, start, end, size);
+
+	wdedup::ProfileSegment segment;
+	segment.id = id;
+	segment.start = start;
+	segment.end = end;
+	segment.size = size;
+	segment.occupancy = occupancy;
+	result.push_back(segment);
+}
+
+/// Maximum number of chunks packed into a segment, which are merged
+/// at once, each of them keeping its cached profile open.
+static const size_t maxPackedChunks = 64;
+
+/**
+ * @brief The consecutive chunks packed into a segment.
+ *
+ * Chunks are the unit of the segment cache, but they are too small 
+ * to be segments, as the cost of planning grows quickly with the 
+ * number of segments. So the cached profiles of consecutive chunks
+ * are merged into a single segment, up to the synchronization 
+ * distance of the original file, with their occurences rebased.
+ */
+struct ChunkPack {
+	/// The range of original file covered by the chunks.
+	fileoff_t start, end;
+
+	/// The start and the cached profile of each chunk.
+	std::vector<std::pair<fileoff_t, 
+		std::unique_ptr<wdedup::ProfileInput>>> chunks;
+
+	/// The occupancy summed over chunks, while the capacity is the
+	/// largest one among them.
+	wdedup::SegmentOccupancy occupancy;
+
+	/// Place the chunk of specified range into the pack.
+	void add(fileoff_t chunkStart, fileoff_t chunkEnd, 
+		std::unique_ptr<wdedup::ProfileInput> cached,
+		wdedup::SegmentOccupancy chunkOccupancy) noexcept;
+
+	/// Merge the chunks into the segment of specified id, and clear 
+	/// the pack. Nothing is done if the pack is empty.
+	void flush(wdedup::Config& cfg, std::vector<wdedup::ProfileSegment>& 
+		result, size_t& segments) throw (wdedup::Error);
+};
+
+void ChunkPack::add(fileoff_t chunkStart, fileoff_t chunkEnd, 
+	std::unique_ptr<wdedup::ProfileInput> cached,
+	wdedup::SegmentOccupancy chunkOccupancy) noexcept {
+	if(chunks.empty()) start = chunkStart;
+	end = chunkEnd;
+	chunks.push_back(std::make_pair(chunkStart, std::move(cached)));
+	uint64_t capacity = std::max(occupancy.capacity, chunkOccupancy.capacity);
+	std::vector<uint64_t*> sum = occupancy.fields();
+	std::vector<uint64_t*> fields = chunkOccupancy.fields();
+	for(size_t i = 0; i < sum.size(); ++ i) *sum[i] += *fields[i];
+	occupancy.capacity = capacity;
+}
+
+void ChunkPack::flush(wdedup::Config& cfg, std::vector<
+	wdedup::ProfileSegment>& result, size_t& segments) throw (wdedup::Error) {
+	if(chunks.empty()) return;
+	wdedup::StatsReport::Scope scope(cfg.stats(), 
+		std::to_string(segments), wdedup::StatsKind::segment);
+	scope.extra("chunks", chunks.size());
+	wdedup::TraceSpan span("pack", segments);
+	std::string segmentName = std::to_string(segments);
+	cfg.remove(segmentName);
+	std::unique_ptr<wdedup::ProfileOutput> out = cfg.openOutput(segmentName);
+
+	// Merge the profiles by the heap of chunks with the least word,
+	// where the same words of different chunks are repeated.
+	auto greater = [&](size_t a, size_t b) {
+		return chunks[a].second->peek().word > chunks[b].second->peek().word;
+	};
+	std::vector<size_t> heap;
+	for(size_t i = 0; i < chunks.size(); ++ i)
+		if(!chunks[i].second->empty()) heap.push_back(i);
+	std::make_heap(heap.begin(), heap.end(), greater);
+	while(!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		size_t least = heap.back(); heap.pop_back();
+		wdedup::ProfileItem item = chunks[least].second->pop();
+		if(!item.repeated) item.occur += chunks[least].first;
+		if(!chunks[least].second->empty()) {
+			heap.push_back(least);
+			std::push_heap(heap.begin(), heap.end(), greater);
+		}
+
+		// The number of occurences is recorded only if all are.
+		while(!heap.empty() && chunks[heap.front()].second->peek().word 
+			== item.word) {
+			std::pop_heap(heap.begin(), heap.end(), greater);
+			size_t same = heap.back(); heap.pop_back();
+			size_t count = chunks[same].second->pop().count;
+			item.repeated = true; item.occur = 0;
+			item.count = (item.count > 0 && count > 0)? item.count + count : 0;
+			if(!chunks[same].second->empty()) {
+				heap.push_back(same);
+				std::push_heap(heap.begin(), heap.end(), greater);
+			}
+		}
+		out->push(std::move(item));
+	}
+	size_t size = out->close();
+	logSegment(cfg, result, segments, start, end, size, occupancy);
+	++ segments;
+	chunks.clear();
+	occupancy = wdedup::SegmentOccupancy();
+}
+
+/// Profile the original file chunk by chunk, looking up the profile of 
+/// each chunk in the segment cache and storing it if it is missing, 
+/// and packing consecutive chunks into segments.
+static void wprofChunks(wdedup::Config& cfg, const std::string& path,
+	size_t syncDistance, fileoff_t& offset, size_t& segments,
+	std::vector<wdedup::ProfileSegment>& result) throw (wdedup::Error) {
+	wdedup::SegmentCache& cache = *cfg.cache();
+	wdedup::ProgressReport& progress = cfg.progress();
+	wdedup::ChunkReader reader(path, offset, 
+		wdedup::ChunkParams(cfg.budget().capacity()));
+	wdedup::ChunkPack pack;
+	size_t packed = 0;
+	while(true) {
+		size_t length = reader.next();
+		if(length == 0) break;
+		fileoff_t chunkStart = offset;
+		offset += length;
+
+		// Look up the profile of the chunk in the cache first.
+		wdedup::SegmentOccupancy occupancy;
+		std::unique_ptr<wdedup::ProfileInput> cached = 
+			cache.openCached(reader.key, occupancy);
+		if(cached != nullptr) {
+			++ cache.hits;
+			cache.savedBytes += length;
+		} else {
+			// Profile the chunk from its content in the memory.
+			++ cache.misses;
+			cfg.budget().adapt();
+			progress.profile(segments);
+			wdedup::MemoryLease lease = 
+				cfg.budget().acquire(cfg.budget().size());
+			std::unique_ptr<wdedup::Dedup> dedup(
+				new wdedup::Dedup(lease.data(), lease.size()));
+			size_t pos; {
+				wdedup::TraceSpan fill("fill", segments);
+				pos = insertWords(*dedup, reader.content, length, 0);
+			}
+			statsAdd(&StatsCounters::tokens, dedup->inserted);
+			statsAdd(&StatsCounters::dedupHits, dedup->repeated);
+
+			// The chunk is cached only if it fits in a single segment, 
+			// otherwise it is profiled into segments of its own.
+			if(pos == length) {
+				occupancy = dedup->occupancy();
+				wdedup::TraceSpan span("pour", segments);
+				wdedup::Dedup::pour(std::move(*dedup), 
+					cache.createCached(reader.key, occupancy));
+				cached = cache.openCached(reader.key, occupancy);
+				if(cached == nullptr) throw wdedup::Error(
+					ENOENT, reader.key, "segment-cache");
+			} else {
+				pack.flush(cfg, result, segments);
+				packed = 0;
+				fileoff_t start = chunkStart;
+				while(true) {
+					wdedup::StatsReport::Scope scope(cfg.stats(), 
+						std::to_string(segments), wdedup::StatsKind::segment);
+					std::string segmentName = std::to_string(segments);
+					cfg.remove(segmentName);
+					occupancy = dedup->occupancy();
+					size_t size = wdedup::Dedup::pour(std::move(*dedup),
+						std::unique_ptr<wdedup::ProfileOutput>(
+						new wdedup::RebasedOutput(cfg.openOutput(
+						segmentName), chunkStart)));
+					fileoff_t end = (pos == length)? offset : chunkStart + pos;
+					logSegment(cfg, result, segments, start, end - 1, 
+						size, occupancy);
+					++ segments;
+					if(pos == length) break;
+
+					// Continue with the remaining words of the chunk.
+					start = end;
+					progress.profile(segments);
+					dedup.reset(); lease = wdedup::MemoryLease();
+					cfg.budget().adapt();
+					lease = cfg.budget().acquire(cfg.budget().size());
+					dedup.reset(new wdedup::Dedup(lease.data(), lease.size()));
+					size_t next = insertWords(*dedup, reader.content, length, pos);
+					if(next == pos) throw std::logic_error(
+						"Insufficient working memory.");
+					statsAdd(&StatsCounters::tokens, dedup->inserted);
+					statsAdd(&StatsCounters::dedupHits, dedup->repeated);
+					pos = next;
+				}
+				progress.consume(offset);
+				continue;
+			}
+		}
+
+		// Pack the chunk, up to the synchronization distance.
+		if(packed > 0 && (pack.chunks.size() >= maxPackedChunks ||
+			(syncDistance > 0 && packed + length > syncDistance))) {
+			pack.flush(cfg, result, segments);
+			packed = 0;
+		}
+		pack.add(chunkStart, offset - 1, std::move(cached), occupancy);
+		packed += length;
+		progress.consume(offset);
+	}
+	pack.flush(cfg, result, segments);
+}
+
 std::vector<wdedup::ProfileSegment>
 wprof(wdedup::Config& cfg, const std::string& path, 
-	size_t syncDistance) throw (wdedup::Error) {
+	size_t syncDistance, fileoff_t start, size_t id) throw (wdedup::Error) {
 
 	// The control counters for wprof routine.
 	std::vector<wdedup::ProfileSegment> result;
-	size_t segments = 0;
-	fileoff_t offset = 0;
+	size_t segments = id;
+	fileoff_t offset = start;
 
 	// Recover previous execution states.
 	if(!cfg.hasRecoveryDone()) while(!(cfg.ilog().eof())) {
@@ -184,10 +587,12 @@ wprof(wdedup::Config& cfg, const std::string& path,
 			// Indicates this is the end of current log
 			// and wprof stage has been completed.
 			return std::move(result);
-		case (char)wdedup::WProfLog::segment:
+		case (char)wdedup::WProfLog::segment: {
 			// Parse the segment parameters.
 			fileoff_t start, end, size;
+			wdedup::SegmentOccupancy occupancy;
 			cfg.ilog() >> start >> end >> size;
+			readOccupancy(cfg.ilog(), occupancy);
 
 			// If the segment start does not matches the 
 			// end of previous segment, report corruption.
@@ -200,11 +605,13 @@ wprof(wdedup::Config& cfg, const std::string& path,
 			segment.start = start;
 			segment.end = end;
 			segment.size = size;
+			segment.occupancy = occupancy;
 			result.push_back(segment);
 
 			// Advance to next segment.
 			++ segments;
 			break;
+		}
 		default:
 			// Report corruption for unknown log item type.
 			cfg.logCorrupt();
@@ -225,6 +632,21 @@ wprof(wdedup::Config& cfg, const std::string& path,
 		throw wdedup::Error(EISDIR, path, role);
 	if(!S_ISREG(st.st_mode)) // Only regular file can be used now.
 		throw wdedup::Error(EIO, path, role);
+	wdedup::ProgressReport& progress = cfg.progress();
+	progress.original(st.st_size);
+	progress.consume(offset);
+
+	// When the segment cache is enabled, the file is divided into 
+	// chunks by content, which are packed into segments.
+	if(cfg.cache() != nullptr) {
+		wprofChunks(cfg, path, syncDistance, offset, segments, result);
+
+		// The empty file is still profiled into an empty segment.
+		if(!result.empty()) {
+			cfg.olog() << wdedup::WProfLog::end << wdedup::sync;
+			return std::move(result);
+		}
+	}
 
 	// Open file and reposition the file read pointer to the offset.
 	// XXX(haoran.luo): We CANNOT use std::fstream here. Because when the file
@@ -235,65 +657,162 @@ wprof(wdedup::Config& cfg, const std::string& path,
 	wdedup::SequentialFile originalFile(path, role, originalMode);
 	wdedup::OriginalFileReader reader;
 
+	// When overlapping is enabled and there're other workers, the 
+	// working memory is divided into two slices, and the previous 
+	// segment is poured by the thread pool while the next segment is 
+	// filled into the other slice. It is opt-in because the segments 
+	// are halved, and there will be twice as many of them to merge.
+	struct PourTask {
+		wdedup::MemoryLease lease;
+		std::unique_ptr<wdedup::Dedup> dedup;
+		std::unique_ptr<wdedup::StatsReport::Scope> scope;
+		size_t id, size;
+		fileoff_t start, end;
+		wdedup::SegmentOccupancy occupancy;
+		std::unique_ptr<wdedup::TaskGroup> worker;
+	};
+	size_t slices = cfg.overlapPour() && cfg.pool().size() > 1? 2 : 1;
+	std::vector<PourTask> tasks(slices);
+
+	// Wait for the pour to complete and write out the log.
+	auto complete = [&](PourTask& task) {
+		if(task.worker == nullptr) return;
+		std::exception_ptr error;
+		try { task.worker->wait(); }
+		catch(...) { error = std::current_exception(); }
+		task.worker = nullptr;
+		task.dedup = nullptr;
+		task.scope = nullptr;
+		task.lease = wdedup::MemoryLease();
+		if(error) std::rethrow_exception(error);
+		logSegment(cfg, result, task.id, task.start, task.end, 
+			task.size, task.occupancy);
+	};
+
 	// Loop reading the files. And writing out the content.
 	bool iseof = false;  
 	const char* inputEntry = nullptr; size_t inputLength = 0;
 	fileoff_t woffset;
-	while(!iseof || inputEntry != nullptr) {
-		auto wm = cfg.workmem();
-		wdedup::Dedup dedup(std::get<0>(wm), std::get<1>(wm));
-
-		// Place the remaining entry first.
-		if(inputEntry != nullptr) if(!dedup.insert(inputEntry, inputLength, woffset)) 
-			throw std::logic_error("Insufficient working memory.");
-		inputEntry = nullptr;
-
-		// Recorded in order to mark milestone when dedup.insert failed.
-		fileoff_t prevoff;
-
-		// Read an item from the original file first.
-		while(!iseof) {
-			prevoff = originalFile.tell();
-
-			// Check whether string based synchronization will be performed.
-			if(syncDistance > 0)
-				if(prevoff - offset > syncDistance) break;
-
-			// Retrieve current string item from original file.
-			inputEntry = reader.readString(originalFile, woffset, inputLength);
-			if(inputEntry != nullptr) {
-				// Place the newly read entry.
-				iseof = false;
-				if(dedup.insert(inputEntry, inputLength, woffset)) 
-					inputEntry = nullptr;
-				else break;
+	size_t k = 0;
+	try {
+		for(; !iseof || inputEntry != nullptr; ++ k) {
+			PourTask& task = tasks[k % slices];
+			complete(task);
+
+			// The budget might be resized at the segment boundary, and
+			// the whole budget is leased for the segment, or half of it
+			// when the segments are poured by other workers.
+			cfg.budget().adapt();
+			progress.profile(segments);
+			task.scope.reset(new wdedup::StatsReport::Scope(cfg.stats(), 
+				std::to_string(segments), wdedup::StatsKind::segment));
+			wdedup::TraceSpan fill("fill", segments);
+			WDEDUP_PROBE2(segment__start, segments, offset);
+			size_t slice = cfg.budget().size() / slices;
+			slice -= slice % wdedup::MemoryBudget::alignment;
+			task.lease = cfg.budget().acquire(slice);
+			task.dedup.reset(new wdedup::Dedup(
+				task.lease.data(), task.lease.size()));
+
+			// Place the remaining entry first. When it does not fit in
+			// the slice, the other pours are completed and the whole
+			// budget is leased for the segment instead.
+			bool placed = false;
+			if(inputEntry != nullptr && slices > 1) {
+				placed = task.dedup->insert(inputEntry, inputLength, woffset);
+				if(!placed) {
+					task.dedup = nullptr;
+					task.lease = wdedup::MemoryLease();
+					for(size_t i = 1; i < slices; ++ i)
+						complete(tasks[(k + i) % slices]);
+					task.lease = cfg.budget().acquire(cfg.budget().size());
+					task.dedup.reset(new wdedup::Dedup(
+						task.lease.data(), task.lease.size()));
+				}
 			}
-			else {
+			wdedup::Dedup& dedup = *task.dedup;
+			if(inputEntry != nullptr && !placed) 
+				if(!dedup.insert(inputEntry, inputLength, woffset)) 
+					throw std::logic_error("Insufficient working memory.");
+			inputEntry = nullptr;
+
+			// Recorded in order to mark milestone when dedup.insert failed.
+			fileoff_t prevoff;
+
+			// Read an item from the original file first.
+			while(!iseof) {
 				prevoff = originalFile.tell();
-				iseof = true;
+
+				// Check whether string based synchronization will be performed.
+				if(syncDistance > 0)
+					if(prevoff - offset > syncDistance) break;
+
+				// Retrieve current string item from original file.
+				inputEntry = reader.readString(originalFile, woffset, inputLength);
+				if(inputEntry != nullptr) {
+					// Place the newly read entry.
+					iseof = false;
+					progress.consume(woffset);
+					if(dedup.insert(inputEntry, inputLength, woffset)) 
+						inputEntry = nullptr;
+					else break;
+				}
+				else {
+					prevoff = originalFile.tell();
+					iseof = true;
+				}
 			}
+			fill.finish();
+
+			// Write the current entries to the underlying file.
+			std::string segmentName = std::to_string(segments);
+			cfg.remove(segmentName);
+			statsAdd(&StatsCounters::tokens, dedup.inserted);
+			statsAdd(&StatsCounters::dedupHits, dedup.repeated);
+			wdedup::SegmentOccupancy occupancy = dedup.occupancy();
+			if(occupancy.items > 0) {
+				wdedup::StatsReport::Scope& scope = *task.scope;
+				scope.extra("items", occupancy.items);
+				scope.extra("poolBytes", occupancy.poolBytes);
+				scope.extra("bytesPerWord", (double)(occupancy.arrayBytes
+					+ occupancy.poolBytes) / occupancy.items);
+				scope.extra("longWordRatio", 
+					(double)occupancy.longWords / occupancy.items);
+				scope.extra("repeatedRatio", 
+					(double)occupancy.repeated / occupancy.tokens);
+			}
+			task.id = segments;
+			task.start = offset;
+			task.end = prevoff - 1;
+			task.occupancy = occupancy;
+
+			// The segment is measured on the thread pouring it as well,
+			// which might not be this thread.
+			task.scope->suspend();
+			task.worker.reset(new wdedup::TaskGroup(cfg.pool()));
+			task.worker->run([&cfg, &task, segmentName]() {
+				wdedup::TraceSpan span("pour", task.id);
+				task.scope->resume();
+				try {
+					task.size = wdedup::Dedup::pour(std::move(*task.dedup), 
+						cfg.openOutput(segmentName));
+				} catch(...) { task.scope->suspend(); throw; }
+				task.scope->suspend();
+			});
+
+			// Advance to next segment.
+			offset = prevoff;
+			++ segments;
+			progress.consume(offset);
 		}
 
-		// Write the current entries to the underlying file.
-		std::string segmentName = std::to_string(segments);
-		cfg.remove(segmentName);
-		size_t size = wdedup::Dedup::pour(std::move(dedup), 
-			cfg.openOutput(segmentName));
-		size_t start = offset, end = prevoff - 1;
-		cfg.olog() << wdedup::WProfLog::segment << 
-			start << end << size << wdedup::sync;
-
-		// Place the segments out.
-		wdedup::ProfileSegment segment;
-		segment.id = segments;
-		segment.start = start;
-		segment.end = end;
-		segment.size = size;
-		result.push_back(segment);
-
-		// Advance to next segment.
-		offset = prevoff;
-		++ segments;
+		// Complete the remaining segments in order.
+		for(size_t i = 0; i < slices; ++ i) 
+			complete(tasks[(k + i) % slices]);
+	} catch(...) {
+		// Wait for the remaining pours before leaving.
+		for(size_t i = 0; i < slices; ++ i) tasks[i].worker = nullptr;
+		throw;
 	}
 
 	// Write out to the log that the wprof stage has finished.
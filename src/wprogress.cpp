@@ -0,0 +1,218 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wprogress.cpp
+ * @author Haoran Luo
+ * @brief wdedup Progress Metrics Implementation
+ *
+ * This file implements the progress metrics, see the header file for
+ * more definition details.
+ */
+#include "impl/wprogress.hpp"
+#include "impl/wstats.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+namespace wdedup {
+
+ProgressReport::ProgressReport() noexcept: current("init"), 
+	fileSize(0), consumed(0), segment(0), mergesPlanned(0), mergesDone(0),
+	costPlanned(0), costDone(0), started(std::chrono::steady_clock::now()),
+	path(), interval(0), exporter(), mutex(), wakeup(), stopping(false),
+	lastBytes(0), lastExport(started), lastMark(0), lastAdvanced(0.0),
+	baseStage(nullptr), baseKind(0), baseWork(0), baseTime(started) {}
+
+ProgressReport::~ProgressReport() noexcept {
+	if(!exporter.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	exporter.join();
+	try { write(); } catch(wdedup::Error&) {}
+}
+
+void ProgressReport::start(std::string path, 
+	std::chrono::milliseconds interval) throw (wdedup::Error) {
+	this->path = std::move(path);
+	this->interval = interval;
+	write();
+
+	// The exporter reports the first failure only, since the textfile
+	// is likely to fail in the same way until it is fixed.
+	exporter = std::thread([this]() {
+		bool reported = false;
+		std::unique_lock<std::mutex> lock(mutex);
+		while(!wakeup.wait_for(lock, this->interval, 
+			[this]() { return stopping; })) {
+			lock.unlock();
+			try { write(); } catch(wdedup::Error& err) {
+				if(!reported) std::cerr << "Warning: progress could not "
+					"be exported to " << err.path << ": " 
+					<< strerror(err.eno) << std::endl;
+				reported = true;
+			}
+			lock.lock();
+		}
+	});
+}
+
+void ProgressReport::stage(const char* name) noexcept {
+	current.store(name);
+}
+
+void ProgressReport::plan(
+	const std::vector<wdedup::MergePlan>& plans) noexcept {
+	uint64_t cost = 0;
+	for(size_t i = 0; i < plans.size(); ++ i) cost += plans[i].cost;
+	mergesPlanned.fetch_add(plans.size());
+	costPlanned.fetch_add(cost);
+}
+
+void ProgressReport::merged(const wdedup::MergePlan& plan) noexcept {
+	mergesDone.fetch_add(1);
+	costDone.fetch_add(plan.cost);
+}
+
+int ProgressReport::measure(uint64_t& done, uint64_t& total) const noexcept {
+	std::string name = current.load();
+	uint64_t size = fileSize.load(), offset = consumed.load();
+	uint64_t planned = costPlanned.load(), cost = costDone.load();
+
+	// The appended content is profiled before it is merged when the
+	// original file grows, so the unfinished one is measured.
+	bool profiling = name == "wprof" || (name == "wgrow" && offset < size);
+	bool merging = name == "wmerge" || (name == "wgrow" && cost < planned);
+	if(profiling && size > 0) {
+		done = offset; total = size; return 1;
+	} else if(merging && planned > 0) {
+		done = cost; total = planned; return 2;
+	} else return 0;
+}
+
+// Write out a metric with its help and type lines.
+static void metric(std::ostream& out, const char* name, const char* type,
+	const char* help, double value, const std::string& labels = "") {
+	out << "# HELP " << name << ' ' << help << '\n'
+		<< "# TYPE " << name << ' ' << type << '\n'
+		<< name << labels << ' ' << value << '\n';
+}
+
+std::string ProgressReport::render() noexcept {
+	auto now = std::chrono::steady_clock::now();
+	double unixNow = std::chrono::duration<double>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	StatsSnapshot io = statsCounters().snapshot();
+	uint64_t bytes = io.bytesRead + io.bytesWritten;
+
+	// The throughput is the I/O bytes per second since last export.
+	double elapsed = std::chrono::duration<double>(now - lastExport).count();
+	double throughput = elapsed > 0? (bytes - lastBytes) / elapsed : 0.0;
+	lastBytes = bytes; lastExport = now;
+
+	// The task is considered advancing whenever there's I/O or work.
+	uint64_t mark = bytes + consumed.load() + mergesDone.load();
+	if(mark != lastMark || lastAdvanced == 0.0) lastAdvanced = unixNow;
+	lastMark = mark;
+
+	// The remaining time is estimated by the rate of work since the
+	// measure of current stage is first seen.
+	const char* name = current.load();
+	uint64_t done = 0, total = 0; 
+	int kind = measure(done, total);
+	if(kind != baseKind || name != baseStage) {
+		baseStage = name; baseKind = kind;
+		baseWork = done; baseTime = now;
+	}
+	double eta = -1.0;
+	double span = std::chrono::duration<double>(now - baseTime).count();
+	if(kind != 0 && done > baseWork && span > 0) {
+		double rate = (done - baseWork) / span;
+		eta = done < total? (total - done) / rate : 0.0;
+	}
+
+	std::stringstream out;
+	out.precision(15);
+	metric(out, "wdedup_stage_info", "gauge", 
+		"The stage being executed.", 1, 
+		std::string("{stage=\"") + name + "\"}");
+	metric(out, "wdedup_elapsed_seconds", "gauge",
+		"Seconds since the task started.", std::chrono::duration<double>(
+			now - started).count());
+	metric(out, "wdedup_original_bytes", "gauge",
+		"Size of the original file.", fileSize.load());
+	metric(out, "wdedup_original_consumed_bytes", "gauge",
+		"Bytes of the original file consumed by profiling.", consumed.load());
+	metric(out, "wdedup_segment_current", "gauge",
+		"Id of the segment being profiled.", segment.load());
+	metric(out, "wdedup_merges_planned", "gauge",
+		"Number of merges in the merge plan.", mergesPlanned.load());
+	metric(out, "wdedup_merges_done", "gauge",
+		"Number of merges in the merge plan that are done.", mergesDone.load());
+	metric(out, "wdedup_merge_cost_planned_bytes", "gauge",
+		"Estimated I/O bytes of the merge plan.", costPlanned.load());
+	metric(out, "wdedup_merge_cost_done_bytes", "gauge",
+		"Estimated I/O bytes of the merges that are done.", costDone.load());
+	metric(out, "wdedup_read_bytes_total", "counter",
+		"Bytes read from files.", io.bytesRead);
+	metric(out, "wdedup_written_bytes_total", "counter",
+		"Bytes written to files.", io.bytesWritten);
+	metric(out, "wdedup_throughput_bytes_per_second", "gauge",
+		"I/O bytes per second since the previous export.", throughput);
+	metric(out, "wdedup_stage_eta_seconds", "gauge",
+		"Estimated seconds remaining in the stage, -1 if unknown.", eta);
+	metric(out, "wdedup_advanced_timestamp_seconds", "gauge",
+		"Unix time when the task was last seen advancing.", lastAdvanced);
+	return out.str();
+}
+
+void ProgressReport::write() throw (wdedup::Error) {
+	static const char* role = "progress";
+	std::string content = render();
+	std::string temporary = path + ".tmp";
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) throw wdedup::Error(errno, temporary, role);
+	size_t written = 0;
+	while(written < content.size()) {
+		ssize_t n = ::write(fd, content.data() + written, 
+			content.size() - written);
+		if(n < 0 && errno == EINTR) continue;
+		if(n < 0) {
+			int eno = errno; close(fd); unlink(temporary.c_str());
+			throw wdedup::Error(eno, temporary, role);
+		}
+		written += n;
+	}
+	close(fd);
+	if(rename(temporary.c_str(), path.c_str()) < 0) {
+		int eno = errno; unlink(temporary.c_str());
+		throw wdedup::Error(eno, path, role);
+	}
+}
+
+} // namespace wdedup
@@ -0,0 +1,103 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wquery.cpp
+ * @author Haoran Luo
+ * @brief wdedup Query Implementation
+ *
+ * This file implements the querying function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include "impl/wpool.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+namespace wdedup {
+
+/// Number of words looked up in a batch.
+static const size_t queryBatch = 4096;
+
+void wquery(
+	wdedup::Config& cfg, size_t root, std::istream& in, 
+	std::ostream& out, size_t threads
+) throw (wdedup::Error) {
+	std::unique_ptr<wdedup::ProfileLookup> lookup =
+		cfg.openLookup(std::to_string(root));
+	if(threads == 0) threads = 1;
+
+	// The word and result of each query in the batch.
+	struct Query {
+		std::string word;
+		bool found;
+		wdedup::ProfileItem item;
+		Query() noexcept: word(), found(false), item("") {}
+	};
+	std::vector<Query> batch(queryBatch);
+
+	while(in) {
+		// Collect a batch of words from the input.
+		size_t size = 0;
+		while(size < queryBatch && std::getline(in, batch[size].word))
+			++ size;
+		if(size == 0) break;
+
+		// Look up the words with multiple workers, each of them
+		// taking the words interleavingly.
+		size_t workers = std::min(threads, size);
+		std::vector<std::exception_ptr> errors(workers);
+		auto work = [&](size_t worker) {
+			try {
+				for(size_t i = worker; i < size; i += workers)
+					batch[i].found = lookup->find(
+						batch[i].word, batch[i].item);
+			} catch(...) {
+				errors[worker] = std::current_exception();
+			}
+		};
+		wdedup::TaskGroup group(cfg.pool());
+		for(size_t i = 0; i < workers; ++ i) 
+			group.run([&work, i]() { work(i); });
+		group.wait();
+		for(size_t i = 0; i < errors.size(); ++ i)
+			if(errors[i]) std::rethrow_exception(errors[i]);
+
+		// Print the results in the order of the input.
+		for(size_t i = 0; i < size; ++ i) {
+			const Query& query = batch[i];
+			out << query.word << '\t';
+			if(!query.found) out << "absent";
+			else if(query.item.repeated) {
+				out << "repeated";
+				if(query.item.count > 0) out << '\t' << query.item.count;
+			}
+			else out << "unique\t" << query.item.occur;
+			out << '\n';
+		}
+	}
+	out.flush();
+}
+
+} // namespace wdedup
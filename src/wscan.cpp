@@ -0,0 +1,149 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wscan.cpp
+ * @author Haoran Luo
+ * @brief wdedup Parallel Block Scanning Implementation
+ *
+ * This file implements the parallel block scanning, see the header
+ * file for more definition details.
+ */
+#include "impl/wscan.hpp"
+#include "impl/wpool.hpp"
+#include "impl/wstats.hpp"
+#include "impl/wtrace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace wdedup {
+
+std::vector<size_t> occurOrder(
+	const std::vector<wdedup::ProfileBlock>& blocks) noexcept {
+	std::vector<size_t> order(blocks.size());
+	for(size_t i = 0; i < order.size(); ++ i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+		return blocks[l].minOccur < blocks[r].minOccur;
+	});
+	return order;
+}
+
+std::vector<size_t> countOrder(
+	const std::vector<wdedup::ProfileBlock>& blocks) noexcept {
+	std::vector<size_t> order(blocks.size());
+	for(size_t i = 0; i < order.size(); ++ i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+		return blocks[l].maxCount > blocks[r].maxCount;
+	});
+	return order;
+}
+
+void wscan(wdedup::Config& cfg, const std::string& path,
+	const std::vector<wdedup::ProfileBlock>& blocks,
+	const std::vector<size_t>& order, size_t workers,
+	wdedup::ScanConsumer& consumer) throw (wdedup::Error) {
+	if(workers == 0) workers = 1;
+
+	// Blocks are claimed by a grain of entries in the visiting order,
+	// so that workers could read adjacent blocks through the same 
+	// input when the blocks are visited in file order.
+	size_t grain = order.size() / (workers * 8);
+	if(grain == 0) grain = 1;
+	std::atomic<size_t> cursor(0);
+
+	// The first error raised by the workers.
+	std::atomic<bool> failed(false);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto work = [&](size_t worker) {
+		try {
+			// The input of current worker, and the block that the
+			// input is positioned at.
+			std::unique_ptr<wdedup::ProfileInput> input;
+			size_t next = blocks.size();
+
+			while(!failed.load()) {
+				size_t first = cursor.fetch_add(grain);
+				if(first >= order.size()) break;
+				size_t last = std::min(first + grain, order.size());
+				wdedup::TraceSpan span("scan", first);
+				for(size_t i = first; i < last; ++ i) {
+					const wdedup::ProfileBlock& block = blocks[order[i]];
+					if(!consumer.accept(worker, block)) {
+						statsAdd(&StatsCounters::blocksSkipped, 1);
+						continue;
+					}
+					statsAdd(&StatsCounters::blocksScanned, 1);
+
+					// Reopen the input unless it is positioned at block.
+					if(input == nullptr || next != order[i])
+						input = cfg.openInput(path, block);
+					for(size_t j = 0; j < block.items && !input->empty(); ++ j)
+						consumer.consume(worker, input->pop());
+					next = order[i] + 1;
+				}
+			}
+		} catch(...) {
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!error) error = std::current_exception();
+			failed.store(true);
+		}
+	};
+
+	// The workers are run as tasks of the pool, and the calling 
+	// thread helps running them while waiting.
+	wdedup::TaskGroup group(cfg.pool());
+	for(size_t i = 0; i < workers; ++ i) group.run([&work, i]() { work(i); });
+	group.wait();
+	if(error) std::rethrow_exception(error);
+}
+
+bool ScanPlan::accept(size_t worker, 
+		const wdedup::ProfileBlock& block) noexcept {
+	// The list is only accessed by the worker, as are the items of
+	// the block, so no synchronization is required here.
+	std::vector<wdedup::ScanConsumer*>& current = accepted[worker];
+	current.clear();
+	for(size_t i = 0; i < consumers.size(); ++ i)
+		if(consumers[i]->accept(worker, block))
+			current.push_back(consumers[i]);
+	return !current.empty();
+}
+
+void ScanPlan::consume(size_t worker, wdedup::ProfileItem item) {
+	// The item is copied for all but the last consumer, which takes
+	// the item itself, so that a single consumer costs no copy.
+	std::vector<wdedup::ScanConsumer*>& current = accepted[worker];
+	for(size_t i = 0; i + 1 < current.size(); ++ i) {
+		wdedup::ProfileItem copy(item.word);
+		copy.repeated = item.repeated;
+		copy.occur = item.occur;
+		copy.count = item.count;
+		current[i]->consume(worker, std::move(copy));
+	}
+	current.back()->consume(worker, std::move(item));
+}
+
+} // namespace wdedup
@@ -0,0 +1,240 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wstats.cpp
+ * @author Haoran Luo
+ * @brief wdedup Performance Statistics Implementation
+ *
+ * This file implements the performance statistics, see the header 
+ * file for more definition details.
+ */
+#include "impl/wstats.hpp"
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+#include <new>
+
+namespace wdedup {
+
+StatsSnapshot StatsSnapshot::operator-(
+	const StatsSnapshot& s) const noexcept {
+	StatsSnapshot d;
+	d.bytesRead = bytesRead - s.bytesRead;
+	d.bytesWritten = bytesWritten - s.bytesWritten;
+	d.readCalls = readCalls - s.readCalls;
+	d.writeCalls = writeCalls - s.writeCalls;
+	d.syncCalls = syncCalls - s.syncCalls;
+	d.itemsRead = itemsRead - s.itemsRead;
+	d.itemsWritten = itemsWritten - s.itemsWritten;
+	d.tokens = tokens - s.tokens;
+	d.dedupHits = dedupHits - s.dedupHits;
+	d.blocksScanned = blocksScanned - s.blocksScanned;
+	d.blocksSkipped = blocksSkipped - s.blocksSkipped;
+	return d;
+}
+
+StatsSnapshot StatsSnapshot::operator+(
+	const StatsSnapshot& s) const noexcept {
+	StatsSnapshot d;
+	d.bytesRead = bytesRead + s.bytesRead;
+	d.bytesWritten = bytesWritten + s.bytesWritten;
+	d.readCalls = readCalls + s.readCalls;
+	d.writeCalls = writeCalls + s.writeCalls;
+	d.syncCalls = syncCalls + s.syncCalls;
+	d.itemsRead = itemsRead + s.itemsRead;
+	d.itemsWritten = itemsWritten + s.itemsWritten;
+	d.tokens = tokens + s.tokens;
+	d.dedupHits = dedupHits + s.dedupHits;
+	d.blocksScanned = blocksScanned + s.blocksScanned;
+	d.blocksSkipped = blocksSkipped + s.blocksSkipped;
+	return d;
+}
+
+StatsSnapshot StatsCounters::snapshot() const noexcept {
+	StatsSnapshot s;
+	s.bytesRead = bytesRead.load();
+	s.bytesWritten = bytesWritten.load();
+	s.readCalls = readCalls.load();
+	s.writeCalls = writeCalls.load();
+	s.syncCalls = syncCalls.load();
+	s.itemsRead = itemsRead.load();
+	s.itemsWritten = itemsWritten.load();
+	s.tokens = tokens.load();
+	s.dedupHits = dedupHits.load();
+	s.blocksScanned = blocksScanned.load();
+	s.blocksSkipped = blocksSkipped.load();
+	return s;
+}
+
+double statsCpuTime() noexcept {
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+		usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+double statsThreadCpuTime() noexcept {
+	// The thread clock is read instead of RUSAGE_THREAD, which might
+	// be sampled by ticks and misses the segments and merges shorter
+	// than a tick.
+	struct timespec now;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) return 0.0;
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void StatsReport::hardware() noexcept {
+	perf.reset(new (std::nothrow) wdedup::PerfCounters);
+}
+
+StatsReport::Scope::Scope(wdedup::StatsReport* report, 
+	std::string name, StatsKind kind) noexcept: report(report), kind(kind),
+	running(false) {
+	if(report == nullptr) return;
+	entry.name = std::move(name);
+	entry.wall = 0.0; entry.cpu = 0.0;
+	entry.counters = StatsSnapshot();
+	for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i) {
+		perfTotal.values[i] = 0.0;
+		perfTotal.counted[i] = true;
+	}
+	resume();
+}
+
+void StatsReport::Scope::resume() noexcept {
+	if(report == nullptr || running) return;
+	bool threaded = kind != StatsKind::stage;
+	running = true;
+	wall = std::chrono::steady_clock::now();
+	cpu = threaded? statsThreadCpuTime() : statsCpuTime();
+	start = (threaded? statsThreadCounters() : statsCounters()).snapshot();
+	if(report->perf != nullptr) perfStart = report->perf->sample(threaded);
+}
+
+void StatsReport::Scope::suspend() noexcept {
+	if(report == nullptr || !running) return;
+	bool threaded = kind != StatsKind::stage;
+	running = false;
+	entry.wall += std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - wall).count();
+	entry.cpu += (threaded? statsThreadCpuTime() : statsCpuTime()) - cpu;
+	entry.counters = entry.counters + ((threaded? statsThreadCounters() 
+		: statsCounters()).snapshot() - start);
+	if(report->perf != nullptr) {
+		PerfSample d = report->perf->sample(threaded) - perfStart;
+		for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i) {
+			perfTotal.values[i] += d.values[i];
+			perfTotal.counted[i] = perfTotal.counted[i] && d.counted[i];
+		}
+	}
+}
+
+void StatsReport::Scope::extra(std::string key, double value) noexcept {
+	if(report == nullptr) return;
+	entry.extra.push_back(std::make_pair(std::move(key), value));
+}
+
+StatsReport::Scope::~Scope() noexcept {
+	if(report == nullptr) return;
+	suspend();
+
+	// The hardware counts are reported in total, and the misses are
+	// also reported per token profiled and per record merged.
+	if(report->perf != nullptr && report->perf->available()) {
+		const PerfSample& d = perfTotal;
+		for(size_t i = 0; i < (size_t)PerfEvent::count; ++ i)
+			if(d.counted[i]) extra(PerfCounters::name((PerfEvent)i), d.values[i]);
+		size_t cycles = (size_t)PerfEvent::cycles;
+		size_t instructions = (size_t)PerfEvent::instructions;
+		if(d.counted[cycles] && d.counted[instructions] && d.values[cycles] > 0)
+			extra("ipc", d.values[instructions] / d.values[cycles]);
+		uint64_t tokens = entry.counters.tokens;
+		uint64_t records = entry.counters.itemsWritten;
+		for(size_t i = (size_t)PerfEvent::cacheMisses; 
+			i < (size_t)PerfEvent::count; ++ i) {
+			if(!d.counted[i]) continue;
+			std::string name = PerfCounters::name((PerfEvent)i);
+			if(tokens > 0) extra(name + "PerToken", d.values[i] / tokens);
+			if(kind == StatsKind::merge && records > 0)
+				extra(name + "PerRecord", d.values[i] / records);
+		}
+	}
+	std::lock_guard<std::mutex> lock(report->mutex);
+	(kind == StatsKind::merge? report->merges : kind == StatsKind::segment?
+		report->segments : report->stages).push_back(std::move(entry));
+}
+
+// Write out an entry as a JSON object.
+static void writeEntry(std::ostream& out, const StatsEntry& e, bool merge) {
+	const StatsSnapshot& c = e.counters;
+	out << "{\"name\": \"" << e.name << "\""
+		<< ", \"wallSeconds\": " << e.wall
+		<< ", \"cpuSeconds\": " << e.cpu
+		<< ", \"bytesRead\": " << c.bytesRead
+		<< ", \"bytesWritten\": " << c.bytesWritten
+		<< ", \"readCalls\": " << c.readCalls
+		<< ", \"writeCalls\": " << c.writeCalls
+		<< ", \"syncCalls\": " << c.syncCalls
+		<< ", \"recordsIn\": " << c.itemsRead
+		<< ", \"recordsOut\": " << c.itemsWritten;
+	if(c.tokens > 0) {
+		out << ", \"tokens\": " << c.tokens
+			<< ", \"tokensPerSecond\": " << (e.wall > 0? c.tokens / e.wall : 0.0)
+			<< ", \"dedupHitRatio\": " << (double)c.dedupHits / c.tokens;
+	}
+	if(c.blocksScanned + c.blocksSkipped > 0) {
+		out << ", \"blocksScanned\": " << c.blocksScanned
+			<< ", \"blocksSkipped\": " << c.blocksSkipped;
+	}
+	for(size_t i = 0; i < e.extra.size(); ++ i)
+		out << ", \"" << e.extra[i].first << "\": " << e.extra[i].second;
+	if(merge) out << ", \"actualCost\": " << c.bytesRead + c.bytesWritten;
+	out << "}";
+}
+
+void StatsReport::write(std::ostream& out) const {
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision(9);
+	out << "{\"stages\": [";
+	for(size_t i = 0; i < stages.size(); ++ i) {
+		out << (i == 0? "\n  " : ",\n  ");
+		writeEntry(out, stages[i], false);
+	}
+	out << "],\n \"merges\": [";
+	for(size_t i = 0; i < merges.size(); ++ i) {
+		out << (i == 0? "\n  " : ",\n  ");
+		writeEntry(out, merges[i], true);
+	}
+	out << "],\n \"segments\": [";
+	for(size_t i = 0; i < segments.size(); ++ i) {
+		out << (i == 0? "\n  " : ",\n  ");
+		writeEntry(out, segments[i], false);
+	}
+	out << "],\n \"hardwareCounters\": \"";
+	if(perf == nullptr) out << "disabled";
+	else if(perf->available()) out << "available";
+	else out << "unavailable: " << perf->unavailable();
+	out << "\"}" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+} // namespace wdedup
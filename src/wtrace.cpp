@@ -0,0 +1,77 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wtrace.cpp
+ * @author Haoran Luo
+ * @brief wdedup Timeline Tracing Implementation
+ *
+ * This file implements the exporting of the traced spans, see the 
+ * header file for more definition details.
+ */
+#include "impl/wtrace.hpp"
+#include <unistd.h>
+
+namespace wdedup {
+
+void traceStart() noexcept {
+	wdedup::TraceRegistry& registry = traceRegistry();
+	registry.epoch = std::chrono::steady_clock::now();
+	registry.enabled.store(true);
+}
+
+void traceWrite(std::ostream& out) {
+	wdedup::TraceRegistry& registry = traceRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out.setf(std::ios::fixed); out.precision(3);
+	long pid = getpid();
+
+	// The timestamps are in unit of microseconds, and each thread is
+	// named after the order of registration.
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	for(size_t i = 0; i < registry.buffers.size(); ++ i) {
+		const wdedup::TraceBuffer& buffer = *registry.buffers[i];
+		out << (first? "\n" : ",\n") << "{\"name\": \"thread_name\", "
+			<< "\"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " 
+			<< buffer.tid << ", \"args\": {\"name\": \"wdedup-" << i << "\"}}";
+		first = false;
+		for(const wdedup::TraceChunk* chunk = &buffer.head; chunk != nullptr;
+			chunk = chunk->next.load(std::memory_order_acquire)) {
+			size_t size = chunk->size.load(std::memory_order_acquire);
+			for(size_t j = 0; j < size; ++ j) {
+				const wdedup::TraceEvent& e = chunk->events[j];
+				out << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"wdedup\""
+					<< ", \"ph\": \"X\", \"ts\": " << e.start / 1000.0
+					<< ", \"dur\": " << e.duration / 1000.0
+					<< ", \"pid\": " << pid << ", \"tid\": " << buffer.tid
+					<< ", \"args\": {\"id\": " << e.id << "}}";
+			}
+		}
+	}
+	out << "\n]}" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+} // namespace wdedup
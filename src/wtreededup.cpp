@@ -30,6 +30,7 @@
 #include "impl/wtreededup.hpp"
 #include "impl/wwmman.hpp"
 #include "wbloom.hpp"
+#include "impl/wprobe.hpp"
 #include <cassert>
 #include <cstring>
 
@@ -44,18 +45,31 @@ RB_GENERATE(TreeDedupRbtree, TreeDedupItem, rbnode, TreeDedupItemCmp);
 namespace wdedup {
 
 TreeDedup::TreeDedup(void* vmaddr, size_t vmsize) noexcept: 
-	wmman(vmaddr, vmsize), root() {
+	inserted(0), repeated(0), longWords(0), wmman(vmaddr, vmsize), root() {
 	RB_INIT(&root);
 }
 
 TreeDedup::TreeDedup(TreeDedup&& rhs) noexcept:
-	wmman(std::move(rhs.wmman)), root() {
+	inserted(rhs.inserted), repeated(rhs.repeated), 
+	longWords(rhs.longWords), wmman(std::move(rhs.wmman)), root() {
 
 	RB_INIT(&root);
 	root.rbh_root = rhs.root.rbh_root;
 	rhs.root.rbh_root = nullptr;
 }
 
+SegmentOccupancy TreeDedup::occupancy() const noexcept {
+	SegmentOccupancy o;
+	o.tokens = inserted;
+	o.repeated = repeated;
+	o.items = wmman.size();
+	o.longWords = longWords;
+	o.arrayBytes = wmman.arrayBytes();
+	o.poolBytes = wmman.poolBytes();
+	o.capacity = wmman.capacity();
+	return o;
+}
+
 bool TreeDedup::insert(const char* word, size_t len, fileoff_t offset) noexcept {
 	if(len == 0) return false; // Invalid word specified.
 
@@ -68,10 +82,14 @@ bool TreeDedup::insert(const char* word, size_t len, fileoff_t offset) noexcept
 		TreeDedupItem search;
 		search.bloom = bloomed;
 
-		// If item is found, mark item as repeated and return directly.
+		// If item is found, mark item as repeated and count it, then
+		// return directly.
 		TreeDedupItem* find = TreeDedupRbtree_RB_FIND(&root, &search);
 		if(find != NULL) {
-			find->occur = 0;
+			if(find->occur & treeDedupRepeated) ++ find->occur;
+			else find->occur = treeDedupRepeated | 2;
+			++ inserted; ++ repeated;
+			WDEDUP_PROBE2(dedup__repeat, offset, len);
 			return true;
 		}
 	}
@@ -79,7 +97,10 @@ bool TreeDedup::insert(const char* word, size_t len, fileoff_t offset) noexcept
 	// Allocate new portion of memory.
 	TreeDedupItem* newitem = nullptr;
 	char* newpool = nullptr;
-	if(!wmman.alloc(allocpool, newitem, newpool)) return false;
+	if(!wmman.alloc(allocpool, newitem, newpool)) {
+		WDEDUP_PROBE2(dedup__full, offset, len);
+		return false;
+	}
 
 	// Initialize the tree node details.
 	newitem->bloom = bloomed;	newitem->occur = offset + 1;
@@ -87,10 +108,13 @@ bool TreeDedup::insert(const char* word, size_t len, fileoff_t offset) noexcept
 		memcpy(newpool, bloomed.pool, allocpool - 1);
 		newpool[allocpool - 1] = '\0';
 		newitem->bloom.pool = newpool;
+		++ longWords;
 	}
 
 	// Insert the tree node into the rbtree.
 	TreeDedupRbtree_RB_INSERT(&root, newitem);
+	++ inserted;
+	WDEDUP_PROBE2(dedup__insert, offset, len);
 
 	return true;
 }
@@ -104,7 +128,11 @@ size_t TreeDedup::pour(
 	TreeDedupItem* it = RB_MIN(TreeDedupRbtree, &dedup.root);
 	for(; it != nullptr; it = TreeDedupRbtree_RB_NEXT(it)) {
 		std::string word = it->bloom.reconstruct();
-		if(it->occur == 0) output->push(ProfileItem(word));
+		if(it->occur & treeDedupRepeated) {
+			ProfileItem item(word);
+			item.count = it->occur & ~treeDedupRepeated;
+			output->push(std::move(item));
+		}
 		else output->push(ProfileItem(word, it->occur - 1));
 	}
 	return output->close();
@@ -0,0 +1,260 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wtune.cpp
+ * @author Haoran Luo
+ * @brief wdedup Host Tuning Profile Implementation
+ *
+ * See corresponding header for interface definitions.
+ */
+#include "impl/wtune.hpp"
+#include "impl/wiobase.hpp"
+#include "impl/wtreededup.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wdedup {
+
+/// The role of files written and read by the calibrations.
+static const char* role = "tune";
+
+/// The buffer sizes that are calibrated.
+static const size_t tuneBufferSizes[] = { 
+	4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20 };
+
+/// Retrieve the seconds elapsed since the specified time.
+static double since(std::chrono::steady_clock::time_point start) noexcept {
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+/// Synchronize the file and drop it from the page cache, so that it
+/// will be read from the disk.
+static void dropCache(const std::string& path) throw (wdedup::Error) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) throw wdedup::Error(errno, path, role);
+	if(fsync(fd) < 0) { 
+		int eno = errno; close(fd); throw wdedup::Error(eno, path, role); 
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+/// Measure the bandwidth of writing the file by records, like the 
+/// profiles are written, with the specified buffer size.
+static double measureWrite(const std::string& path, 
+	size_t size, size_t bufsize) throw (wdedup::Error) {
+	unlink(path.c_str());
+	wdedup::FileMode mode;
+	mode.bufsize = bufsize;
+	char record[64]; memset(record, 'w', sizeof(record));
+	auto start = std::chrono::steady_clock::now();
+	{
+		wdedup::AppendFile file(path, role, mode);
+		for(size_t written = 0; written < size; written += sizeof(record))
+			file.write(record, sizeof(record));
+		file.sync();
+	}
+	dropCache(path);
+	return size / since(start);
+}
+
+/// Measure the bandwidth of scanning the file inside the buffer, like 
+/// the original file is read, with the specified buffer size.
+static double measureRead(const std::string& path, 
+	size_t size, size_t bufsize) throw (wdedup::Error) {
+	dropCache(path);
+	wdedup::FileMode mode;
+	mode.bufsize = bufsize;
+	volatile size_t lines = 0;
+	auto start = std::chrono::steady_clock::now();
+	{
+		wdedup::SequentialFile file(path, role, mode);
+		while(!file.eof()) {
+			char* ptr; size_t available;
+			file.bufferptr(ptr, available);
+			lines += std::count(ptr, ptr + available, '\n');
+			file.bufferskip(available);
+		}
+	}
+	return size / since(start);
+}
+
+/// Measure the median latency of synchronizing the log.
+static double measureFsync(const std::string& path) throw (wdedup::Error) {
+	unlink(path.c_str());
+	wdedup::FileMode mode;
+	mode.log = true;
+	std::vector<double> latencies;
+	char record[4096]; memset(record, 'l', sizeof(record));
+	{
+		wdedup::AppendFile file(path, role, mode);
+		for(size_t i = 0; i < 16; ++ i) {
+			file.write(record, sizeof(record));
+			auto start = std::chrono::steady_clock::now();
+			file.sync();
+			latencies.push_back(since(start));
+		}
+	}
+	unlink(path.c_str());
+	std::sort(latencies.begin(), latencies.end());
+	return latencies[latencies.size() / 2];
+}
+
+/// Measure the bytes of words inserted into the engine per second, on 
+/// words drawn from a skewed distribution, until the working memory is
+/// full. The delimiter of each word is counted as it is read.
+static double measureInsert(size_t workmem) {
+	// The words are generated before measuring.
+	std::vector<char> data;
+	std::vector<std::pair<size_t, size_t>> spans;
+	uint64_t state = 0x9e3779b97f4a7c15ull;
+	while(data.size() < workmem * 2) {
+		state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+		double u = (state >> 11) * (1.0 / 9007199254740992.0);
+		uint64_t index = (uint64_t)((1 << 22) * u * u * u);
+		char word[32]; int len = snprintf(word, sizeof(word), 
+			"%c%llx", 'a' + (int)(index % 26), (unsigned long long)index);
+		spans.push_back(std::make_pair(data.size(), (size_t)len));
+		data.insert(data.end(), word, word + len);
+	}
+
+	// The working memory is touched before measuring.
+	std::unique_ptr<char[]> memory(new char[workmem]);
+	memset(memory.get(), 0, workmem);
+	wdedup::TreeDedup dedup(memory.get(), workmem);
+	size_t inserted = 0, bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(; inserted < spans.size(); ++ inserted) {
+		if(!dedup.insert(&data[spans[inserted].first], 
+			spans[inserted].second, spans[inserted].first)) break;
+		bytes += spans[inserted].second + 1;
+	}
+	return bytes / since(start);
+}
+
+wdedup::TuningProfile wtune(const std::string& scratch, 
+	size_t size, std::ostream& log) throw (wdedup::Error) {
+	if(mkdir(scratch.c_str(), 0755) < 0 && errno != EEXIST)
+		throw wdedup::Error(errno, scratch, role);
+	std::string data = scratch + "/tune.data";
+	wdedup::TuningProfile profile;
+
+	// Sweep the buffer sizes for reading and writing. The original file
+	// is only read, while the profiles are both written and read.
+	double bestProfile = 0.0;
+	for(size_t bufsize : tuneBufferSizes) {
+		double write = measureWrite(data, size, bufsize);
+		double read = measureRead(data, size, bufsize);
+		log << "buffer " << (bufsize >> 10) << "KB: write " 
+			<< (size_t)(write / 1e6) << "MB/s, read " 
+			<< (size_t)(read / 1e6) << "MB/s" << std::endl;
+		if(read > profile.readBandwidth) {
+			profile.readBandwidth = read;
+			profile.bufferSizes["original-file"] = bufsize;
+		}
+		double both = 1.0 / (1.0 / read + 1.0 / write);
+		if(both > bestProfile) {
+			bestProfile = both;
+			profile.bufferSizes["profile-simple"] = bufsize;
+		}
+	}
+	unlink(data.c_str());
+
+	profile.fsyncSeconds = measureFsync(data);
+	log << "fsync: " << profile.fsyncSeconds * 1e3 << "ms" << std::endl;
+	profile.insertBandwidth = measureInsert(16 << 20);
+	log << "insert: " << (size_t)(profile.insertBandwidth / 1e6) 
+		<< "MB/s" << std::endl;
+	return profile;
+}
+
+size_t TuningProfile::syncDistance(
+	size_t minimum, size_t maximum) const noexcept {
+	if(fsyncSeconds <= 0.0 || readBandwidth <= 0.0 
+		|| insertBandwidth <= 0.0) return maximum;
+	double bandwidth = std::min(readBandwidth, insertBandwidth);
+	double distance = fsyncSeconds * bandwidth * 100.0;
+	if(distance < minimum) return minimum;
+	if(distance > maximum) return maximum;
+	return (size_t)distance;
+}
+
+bool TuningProfile::load(const std::string& path) noexcept {
+	std::ifstream in(path);
+	if(!in) return false;
+	std::string line;
+	while(std::getline(in, line)) {
+		std::stringstream fields(line);
+		std::string key; fields >> key;
+		if(key == "read-bandwidth") fields >> readBandwidth;
+		else if(key == "fsync-seconds") fields >> fsyncSeconds;
+		else if(key == "insert-bandwidth") fields >> insertBandwidth;
+		else if(key == "buffer-size") {
+			std::string role; size_t size = 0;
+			if(fields >> role >> size && size > 0) bufferSizes[role] = size;
+		}
+	}
+	return true;
+}
+
+void TuningProfile::save(const std::string& path) const throw (wdedup::Error) {
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary);
+		out << "# wdedup tuning profile, measured by \"wdedup tune\".\n"
+			<< "read-bandwidth " << readBandwidth << "\n"
+			<< "fsync-seconds " << fsyncSeconds << "\n"
+			<< "insert-bandwidth " << insertBandwidth << "\n";
+		for(const auto& bufferSize : bufferSizes) out << "buffer-size " 
+			<< bufferSize.first << " " << bufferSize.second << "\n";
+		if(!out.flush()) {
+			unlink(temporary.c_str());
+			throw wdedup::Error(EIO, temporary, "tuning");
+		}
+	}
+	if(rename(temporary.c_str(), path.c_str()) < 0) {
+		int eno = errno; unlink(temporary.c_str());
+		throw wdedup::Error(eno, path, "tuning");
+	}
+}
+
+std::string tuningPath() noexcept {
+	const char* path = getenv("WDEDUP_TUNING");
+	if(path != nullptr) return path;
+	const char* home = getenv("HOME");
+	return std::string(home != nullptr? home : ".") + "/.wdedup-tuning";
+}
+
+} // namespace wdedup
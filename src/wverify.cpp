@@ -0,0 +1,74 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file wverify.cpp
+ * @author Haoran Luo
+ * @brief wdedup Verify-First Implementation
+ *
+ * This file implements the verifying function, see the header file
+ * for more definition details.
+ */
+#include "wdedup.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace wdedup {
+
+bool wverify(
+	wdedup::Config& cfg, const std::vector<wdedup::ProfileSegment>& segments,
+	size_t candidates, std::string& result, size_t threads
+) throw (wdedup::Error) {
+	result = "";
+	if(candidates == 0 || segments.size() == 0) return false;
+
+	// The segments might have been merged and garbage collected if
+	// there's still log to recover after wprof.
+	if(!cfg.hasRecoveryDone() && !cfg.ilog().eof()) return false;
+
+	// The singular words of the first segment are the earliest ones,
+	// so the earliest of them that is absent from other segments 
+	// must be the result of find-first stage.
+	std::vector<std::string> words = wdedup::wfindtopn(
+		cfg, segments[0].id, candidates, threads);
+
+	// Look up the candidates in order from the other segments.
+	std::vector<std::unique_ptr<wdedup::ProfileLookup>> lookups;
+	for(size_t i = 1; i < segments.size(); ++ i)
+		lookups.push_back(cfg.openLookup(std::to_string(segments[i].id)));
+	wdedup::ProfileItem item("");
+	for(size_t i = 0; i < words.size(); ++ i) {
+		bool found = false;
+		for(size_t j = 0; j < lookups.size() && !found; ++ j)
+			found = lookups[j]->find(words[i], item);
+		if(!found) {
+			result = std::move(words[i]);
+			return true;
+		}
+	}
+
+	// The candidates run out, the result must be determined by
+	// merging, unless there's only one segment.
+	return segments.size() == 1 && words.size() < candidates;
+}
+
+} // namespace wdedup
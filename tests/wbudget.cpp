@@ -0,0 +1,153 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file tests/wbudget.cpp
+ * @author Haoran Luo
+ * @brief wdedup memory budget tests.
+ *
+ * This file is unit test for wbudget.cpp. See corresponding header 
+ * and source file for details.
+ */
+#include "gtest/gtest.h"
+#include "impl/wbudget.hpp"
+#include "impl/wpressure.hpp"
+#include <fstream>
+#include <sys/stat.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * wbudget.lease: this file tests that the leases are carved from the
+ * working memory without overlapping, and the returned regions are
+ * coalesced so that the whole memory could be leased again.
+ */
+TEST(wbudget, lease) {
+	std::vector<char> arena(4096);
+	wdedup::MemoryBudget budget(arena.data(), arena.size());
+	ASSERT_EQ(budget.size(), 4096);
+	ASSERT_THROW(budget.acquire(4097), std::logic_error);
+	{
+		// Lease the whole memory in four quarters.
+		std::vector<wdedup::MemoryLease> leases;
+		for(size_t i = 0; i < 4; ++ i) {
+			leases.push_back(budget.acquire(1000));
+			ASSERT_EQ(leases.back().size(), 1024);
+			ASSERT_EQ(leases.back().data(), arena.data() + 1024 * i);
+		}
+		ASSERT_EQ(budget.tryAcquire(1).data(), nullptr);
+
+		// Release the inner quarters, which must be coalesced.
+		leases[2] = wdedup::MemoryLease();
+		leases[1] = wdedup::MemoryLease();
+		wdedup::MemoryLease inner = budget.tryAcquire(2048);
+		ASSERT_EQ(inner.data(), arena.data() + 1024);
+	}
+	ASSERT_EQ(budget.peakLeased(), 4096);
+	ASSERT_EQ(budget.acquire(4096).data(), arena.data());
+}
+
+/**
+ * wbudget.pressure: this file tests that the request exceeding the
+ * remaining memory waits until other leases are returned, so that 
+ * the leased memory never exceeds the budget.
+ */
+TEST(wbudget, pressure) {
+	std::vector<char> arena(64 * 16);
+	wdedup::MemoryBudget budget(arena.data(), arena.size());
+	std::atomic<size_t> inuse(0), violations(0);
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < 8; ++ i) threads.emplace_back([&, i]() {
+		for(size_t j = 0; j < 1000; ++ j) {
+			size_t size = 64 * (1 + (i + j) % 6);
+			wdedup::MemoryLease lease = budget.acquire(size);
+			if(inuse.fetch_add(size) + size > arena.size()) 
+				violations.fetch_add(1);
+			std::this_thread::yield();
+			inuse.fetch_sub(size);
+		}
+	});
+	for(size_t i = 0; i < threads.size(); ++ i) threads[i].join();
+	ASSERT_EQ(violations.load(), 0);
+	ASSERT_LE(budget.peakLeased(), arena.size());
+}
+
+/**
+ * wbudget.resize: this file tests that no region beyond the size of
+ * the budget is leased after shrinking, and the budget could be grown
+ * back up to the size of the working memory.
+ */
+TEST(wbudget, resize) {
+	std::vector<char> arena(4096);
+	wdedup::MemoryBudget budget(arena.data(), arena.size());
+	wdedup::MemoryLease lease = budget.acquire(1024);
+	ASSERT_EQ(budget.resize(2000), 1984);
+	ASSERT_EQ(budget.size(), 1984);
+	ASSERT_THROW(budget.acquire(2048), std::logic_error);
+	ASSERT_EQ(budget.tryAcquire(1024).data(), nullptr);
+	ASSERT_EQ(budget.tryAcquire(960).data(), arena.data() + 1024);
+	ASSERT_EQ(budget.resize(8192), 4096);
+	ASSERT_EQ(budget.acquire(3072).data(), arena.data() + 1024);
+}
+
+/**
+ * wbudget.governor: this file tests that the cgroup governor halves 
+ * the budget under pressure, and doubles it once the pressure is 
+ * relieved with enough headroom under memory.high.
+ */
+TEST(wbudget, governor) {
+	static const char* cgroup = "wbudget.governor.temp";
+	mkdir(cgroup, S_IRWXU);
+	auto write = [&](const char* name, const char* content) {
+		std::ofstream file(std::string(cgroup) + "/" + name);
+		file << content << std::endl;
+	};
+	write("memory.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=0");
+	write("memory.high", "max");
+	write("memory.current", "1048576");
+
+	std::vector<char> arena(64 * 1024);
+	wdedup::MemoryBudget budget(arena.data(), arena.size());
+	wdedup::MemoryGovernorCgroup governor(8 * 1024, nullptr, cgroup);
+	ASSERT_TRUE(governor.available());
+	budget.govern(&governor);
+
+	// Shrink under pressure, down to the minimum size.
+	write("memory.pressure", "some avg10=25.00 avg60=3.00 avg300=1.00 total=9");
+	budget.adapt(); ASSERT_EQ(budget.size(), 32 * 1024);
+	budget.adapt(); budget.adapt(); budget.adapt();
+	ASSERT_EQ(budget.size(), 8 * 1024);
+
+	// Grow back without pressure, unless close to memory.high.
+	write("memory.pressure", "some avg10=0.10 avg60=3.00 avg300=1.00 total=9");
+	write("memory.high", "1200000");
+	budget.adapt(); ASSERT_EQ(budget.size(), 8 * 1024);
+	write("memory.high", "max");
+	budget.adapt(); ASSERT_EQ(budget.size(), 16 * 1024);
+	budget.adapt(); budget.adapt(); budget.adapt();
+	ASSERT_EQ(budget.size(), 64 * 1024);
+
+	for(const char* name : { "memory.pressure", "memory.high", "memory.current" })
+		remove((std::string(cgroup) + "/" + name).c_str());
+	rmdir(cgroup);
+}
@@ -0,0 +1,156 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file tests/wgrow.cpp
+ * @author Haoran Luo
+ * @brief wdedup Grow tests.
+ *
+ * This file is unit test for wgrow.cpp. See corresponding header 
+ * and source file for details.
+ */
+#include "gtest/gtest.h"
+#include "wdedup.hpp"
+#include "impl/wmpdp.hpp"
+#include "impl/wpflsimple.hpp"
+#include "impl/wbudget.hpp"
+#include "impl/wpool.hpp"
+#include "impl/wprogress.hpp"
+#include <cstdio>
+#include <map>
+#include <vector>
+
+/// Configuration of the tasks whose files are prefixed under the
+/// current directory, which are never recovered.
+struct GrowConfig : public wdedup::Config {
+	std::string prefix;
+	wdedup::FileMode mode;
+	std::vector<char> arena;
+	wdedup::MemoryBudget memoryBudget;
+	wdedup::ThreadPool threadPool;
+	wdedup::ProgressReport progressReport;
+	wdedup::AppendFile log;
+
+	GrowConfig(std::string prefix) throw (wdedup::Error): 
+		prefix(std::move(prefix)), arena(1 << 20),
+		memoryBudget(arena.data(), arena.size()), threadPool(1),
+		log(this->prefix + "log", "log", wdedup::FileMode()) {}
+
+	virtual bool hasRecoveryDone() throw (wdedup::Error) override { return true; }
+	virtual wdedup::SequentialFile& ilog() noexcept override { std::abort(); }
+	virtual wdedup::AppendFile& olog() noexcept override { return log; }
+	virtual void recoveryDone() throw (wdedup::Error) override {}
+	virtual void logCorrupt() throw (wdedup::Error) override {
+		throw wdedup::Error(EIO, prefix + "log", "log");
+	}
+	virtual std::unique_ptr<wdedup::ProfileOutput> openOutput(
+		std::string path) throw (wdedup::Error) override {
+		return std::unique_ptr<wdedup::ProfileOutput>(
+			new wdedup::ProfileOutputSimple(prefix + path, mode));
+	}
+	virtual std::unique_ptr<wdedup::ProfileInput> openInput(
+		std::string path) throw (wdedup::Error) override {
+		return std::unique_ptr<wdedup::ProfileInput>(
+			new wdedup::ProfileInputSimple(prefix + path, mode));
+	}
+	virtual std::unique_ptr<wdedup::ProfileInput> openInput(std::string, 
+		const wdedup::ProfileBlock&) throw (wdedup::Error) override { std::abort(); }
+	virtual std::vector<wdedup::ProfileBlock> openIndex(
+		std::string path) throw (wdedup::Error) override {
+		return wdedup::profileIndexSimple(prefix + path, mode);
+	}
+	virtual std::unique_ptr<wdedup::ProfileLookup> openLookup(
+		std::string path) throw (wdedup::Error) override {
+		return std::unique_ptr<wdedup::ProfileLookup>(
+			new wdedup::ProfileLookupSimple(prefix + path, mode));
+	}
+	virtual std::unique_ptr<wdedup::ProfileInput> openSingularInput(
+		std::string) throw (wdedup::Error) override { std::abort(); }
+	virtual void remove(std::string path) throw (wdedup::Error) override {
+		wdedup::profileRemoveSimple(prefix + path);
+	}
+	virtual wdedup::MemoryBudget& budget() noexcept override { return memoryBudget; }
+	virtual wdedup::SegmentCache* cache() noexcept override { return nullptr; }
+	virtual wdedup::ThreadPool& pool() noexcept override { return threadPool; }
+	virtual bool overlapPour() noexcept override { return false; }
+	virtual wdedup::StatsReport* stats() noexcept override { return nullptr; }
+	virtual wdedup::ProgressReport& progress() noexcept override {
+		return progressReport;
+	}
+};
+
+/**
+ * wgrow.midword: this file tests that the content appended in the
+ * middle of the last word is profiled as the continuation of the word,
+ * whether the occurence of the word is trimmed from the previous final
+ * profile, or the whole file has to be profiled again.
+ */
+TEST(wgrow, midword) {
+	struct Case {
+		const char* content;
+		const char* appended;
+		std::map<std::string, wdedup::fileoff_t> singular;
+	};
+	std::vector<Case> cases = {
+		// The singular word is trimmed.
+		{ "alpha beta alpha gam", "ma beta delta", 
+			{ {"gamma", 17}, {"delta", 28} } },
+
+		// The repeated word could not be trimmed.
+		{ "gam x gam gam", "ma", { {"x", 4}, {"gamma", 10} } },
+
+		// The whole profiled content is a single word.
+		{ "al", "pha beta", { {"alpha", 0}, {"beta", 6} } },
+	};
+	static const char* filename = "wgrow.midword.temp";
+	static const std::string prefix = "wgrow.midword.temp.";
+	for(const Case& c : cases) {
+		FILE* file = fopen(filename, "w");
+		ASSERT_NE(file, nullptr);
+		fputs(c.content, file); fclose(file);
+		std::remove((prefix + "log").c_str());
+
+		// Profile and merge the original content.
+		GrowConfig cfg(prefix);
+		std::vector<wdedup::ProfileSegment> segments = 
+			wdedup::wprof(cfg, filename);
+		wdedup::MergePlannerDP planner(cfg, segments);
+		size_t root = wdedup::wmerge(cfg, planner, false);
+
+		// Grow the original file in the middle of the last word.
+		file = fopen(filename, "a");
+		ASSERT_NE(file, nullptr);
+		fputs(c.appended, file); fclose(file);
+		root = wdedup::wgrow(cfg, filename, segments, root, 0, false, true);
+
+		std::map<std::string, wdedup::fileoff_t> singular;
+		std::unique_ptr<wdedup::ProfileInput> input = 
+			cfg.openInput(std::to_string(root));
+		while(!input->empty()) {
+			wdedup::ProfileItem item = input->pop();
+			if(!item.repeated) singular[item.word] = item.occur;
+		}
+		EXPECT_EQ(singular, c.singular) << c.content << c.appended;
+		cfg.remove(std::to_string(root));
+	}
+	std::remove(filename);
+	std::remove((prefix + "log").c_str());
+}
@@ -45,20 +45,22 @@ static std::function<void(int)> getReportFunction(
 
 // Mocked up sequential-scan file driver for testing.
 SequentialFile::SequentialFile(std::string path, std::string role,
-	FileMode) throw (wdedup::Error) : pimpl(nullptr) {
+	FileMode mode) throw (wdedup::Error) : pimpl(nullptr) {
 
+	size_t bufsize = mode.bufferSize(role);
 	pimpl = std::unique_ptr<SequentialFile::Impl>(
-		new SequentialFileBase(path.c_str(), 
-		getReportFunction(path, role), 0));
+		new SequentialFileBase(path.c_str(), getReportFunction(path, role), 
+		0, bufsize > 0? bufsize : bufsiz));
 }
 
 // Mocked up append-only file driver for testing.
 AppendFile::AppendFile(std::string path, std::string role, 
-	FileMode) throw (wdedup::Error) : pimpl(nullptr) {
+	FileMode mode) throw (wdedup::Error) : pimpl(nullptr) {
 
+	size_t bufsize = mode.bufferSize(role);
 	pimpl = std::unique_ptr<AppendFile::Impl>(
-		new AppendFileBuffer(path.c_str(),
-		getReportFunction(path, role)));
+		new AppendFileBuffer(path.c_str(), getReportFunction(path, role),
+		bufsize > 0? bufsize : bufsiz));
 }
 
 }
@@ -100,3 +102,51 @@ TEST(wio, readwrite) {
 		EXPECT_TRUE(sb.eof()); // Make sure no more content is written.
 	}
 }
+
+/**
+ * wio.buffersize: this file tests reading and writing files with
+ * buffer sizes configured by role, which are not aligned with the
+ * size of data, and the end of file must be told at the exact end.
+ */
+TEST(wio, buffersize) {
+	static const size_t times = 100000;
+	static const char* filename = "wio.buffersize.temp";
+	remove(filename);	// Make sure absence of file.
+
+	for(size_t bufsize : { 1, 3, 7, 65536 }) {
+		wdedup::FileMode mode;
+		wdedup::FileMode::defaultBuffers()["test"] = bufsize;
+		EXPECT_EQ(mode.bufferSize("test"), bufsize);
+		EXPECT_EQ(mode.bufferSize("other"), 0);
+		wdedup::FileMode own(mode); own.bufsize = 5;
+		EXPECT_EQ(own.bufferSize("test"), 5);
+
+		// Write phase of the append file.
+		{
+			wdedup::AppendFile wb(filename, "test", mode);
+			for(size_t i = 0; i < times; i ++) wb << (int)i;
+			wb << wdedup::sync;
+			EXPECT_EQ(wb.tell(), times * sizeof(int));
+		}
+
+		// Read phase of the append file, by both read and bufferptr.
+		{
+			wdedup::SequentialFile sb(filename, "test", mode);
+			int number; 
+			for(size_t i = 0; i < times / 2; i ++) {
+				sb >> number; EXPECT_EQ(number, (int)i); }
+			size_t skipped = 0;
+			while(!sb.eof()) {
+				char* ptr; size_t size;
+				sb.bufferptr(ptr, size);
+				EXPECT_GT(size, 0);
+				sb.bufferskip(size);
+				skipped += size;
+			}
+			EXPECT_EQ(skipped, times / 2 * sizeof(int));
+			EXPECT_EQ(sb.tell(), times * sizeof(int));
+		}
+		remove(filename);
+	}
+	wdedup::FileMode::defaultBuffers().erase("test");
+}
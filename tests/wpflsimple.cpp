@@ -20,19 +20,205 @@
  * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
  * THE SOFTWARE. */
 /**
- * @file tests/wpflbase.cpp
+ * @file tests/wpflsimple.cpp
  * @author Haoran Luo
- * @brief wdedup I/O base tests.
+ * @brief wdedup Simple Profile tests.
  *
- * This file is unit test for wpflbase.cpp. See corresponding header 
+ * This file is unit test for wpflsimple.cpp. See corresponding header 
  * and source file for details.
  */
 #include "gtest/gtest.h"
 #include "wio.hpp"
 #include "impl/wpflsimple.hpp"
+#include <cstdio>
+#include <unistd.h>
 
 /**
- * wprofile.readwrite: currently a stub for building wpflbase.
+ * wprofile.readwrite: this file tests the writing and reading of the
+ * simple profile, and whether the block summaries are recorded.
  */
 TEST(wprofile, readwrite) {
+	// Number of profile items written to the profile.
+	static const size_t items = 100000;
+	static const char* filename = "wprofile.readwrite.temp";
+	wdedup::profileRemoveSimple(filename);	// Make sure absence of file.
+	wdedup::FileMode mode;
+
+	// Every third item is marked repeated, others are singular and
+	// their occurence decreases as the word increases.
+	auto wordOf = [](size_t i) -> std::string {
+		char word[32]; snprintf(word, sizeof(word), "word%08zu", i);
+		return std::string(word);
+	};
+
+	// Write phase of the profile.
+	{
+		wdedup::ProfileOutputSimple output(filename, mode);
+		for(size_t i = 0; i < items; ++ i) {
+			if(i % 3 == 0) output.push(wdedup::ProfileItem(wordOf(i)));
+			else output.push(wdedup::ProfileItem(wordOf(i), items - i));
+		}
+		output.close();
+	}
+
+	// Read phase of the profile.
+	{
+		wdedup::ProfileInputSimple input(filename, mode);
+		for(size_t i = 0; i < items; ++ i) {
+			ASSERT_FALSE(input.empty());
+			wdedup::ProfileItem item = input.pop();
+			EXPECT_EQ(item.word, wordOf(i));
+			EXPECT_EQ(item.repeated, i % 3 == 0);
+			if(!item.repeated) { EXPECT_EQ(item.occur, items - i); }
+		}
+		EXPECT_TRUE(input.empty());
+	}
+
+	// Verify the block summaries against the profile.
+	std::vector<wdedup::ProfileBlock> blocks = 
+		wdedup::profileIndexSimple(filename, mode);
+	ASSERT_GT(blocks.size(), 1);
+	size_t first = 0;
+	for(size_t i = 0; i < blocks.size(); ++ i) {
+		// Each block must start with the item after previous block.
+		wdedup::FileMode blockMode(mode);
+		blockMode.seekset = blocks[i].offset;
+		wdedup::ProfileInputSimple input(filename, blockMode);
+		ASSERT_FALSE(input.empty());
+		EXPECT_EQ(input.peek().word, wordOf(first));
+
+		// The minimum occurence falls on the last singular item.
+		size_t last = first + blocks[i].items - 1;
+		if(last % 3 == 0) -- last;
+		EXPECT_EQ(blocks[i].minOccur, items - last);
+		first += blocks[i].items;
+
+		// The blocks must be adjacent to each other.
+		if(i + 1 < blocks.size()) {
+			EXPECT_EQ(blocks[i].offset + blocks[i].size, blocks[i + 1].offset);
+		}
+	}
+	EXPECT_EQ(first, items);
+}
+
+/**
+ * wprofile.lookup: this file tests looking up words in the simple 
+ * profile through the sparse index and the bloom filters.
+ */
+TEST(wprofile, lookup) {
+	// Only even words are written, so odd words must be absent.
+	static const size_t items = 50000;
+	static const char* filename = "wprofile.lookup.temp";
+	wdedup::profileRemoveSimple(filename);	// Make sure absence of file.
+	wdedup::FileMode mode;
+	auto wordOf = [](size_t i) -> std::string {
+		char word[32]; snprintf(word, sizeof(word), "word%08zu", i);
+		return std::string(word);
+	};
+	{
+		wdedup::ProfileOutputSimple output(filename, mode);
+		for(size_t i = 0; i < items; i += 2) {
+			if(i % 3 == 0) output.push(wdedup::ProfileItem(wordOf(i)));
+			else output.push(wdedup::ProfileItem(wordOf(i), i));
+		}
+		output.close();
+	}
+
+	// Look up every written and absent word.
+	wdedup::ProfileLookupSimple lookup(filename, mode);
+	wdedup::ProfileItem item("");
+	for(size_t i = 0; i < items; ++ i) {
+		if(i % 2 == 0) {
+			ASSERT_TRUE(lookup.find(wordOf(i), item));
+			EXPECT_EQ(item.word, wordOf(i));
+			EXPECT_EQ(item.repeated, i % 3 == 0);
+			if(!item.repeated) { EXPECT_EQ(item.occur, i); }
+		} else EXPECT_FALSE(lookup.find(wordOf(i), item));
+	}
+
+	// Words out of the range of the profile must be absent.
+	EXPECT_FALSE(lookup.find("", item));
+	EXPECT_FALSE(lookup.find("a", item));
+	EXPECT_FALSE(lookup.find("zzzz", item));
+}
+
+/**
+ * wprofile.counting: this file tests the number of occurences of the
+ * repeated items, which is written only if counting is enabled.
+ */
+TEST(wprofile, counting) {
+	static const size_t items = 20000;
+	static const char* filename = "wprofile.counting.temp";
+	wdedup::FileMode mode;
+	auto wordOf = [](size_t i) -> std::string {
+		char word[32]; snprintf(word, sizeof(word), "word%08zu", i);
+		return std::string(word);
+	};
+
+	// Every other item is repeated, with counts of various lengths.
+	for(int counting = 0; counting <= 1; ++ counting) {
+		wdedup::profileRemoveSimple(filename);	// Make sure absence of file.
+		{
+			wdedup::ProfileOutputSimple output(filename, mode, counting);
+			for(size_t i = 0; i < items; ++ i) {
+				if(i % 2 == 0) {
+					wdedup::ProfileItem item(wordOf(i));
+					item.count = (i + 2) * (i + 2);
+					output.push(std::move(item));
+				} else output.push(wdedup::ProfileItem(wordOf(i), i));
+			}
+			output.close();
+		}
+
+		// Read back the counts of items.
+		wdedup::ProfileInputSimple input(filename, mode);
+		for(size_t i = 0; i < items; ++ i) {
+			ASSERT_FALSE(input.empty());
+			wdedup::ProfileItem item = input.pop();
+			EXPECT_EQ(item.word, wordOf(i));
+			if(i % 2 != 0) { EXPECT_EQ(item.count, 1); }
+			else { EXPECT_EQ(item.count, counting? (i + 2) * (i + 2) : 0); }
+		}
+		EXPECT_TRUE(input.empty());
+
+		// The maximum count falls on the last repeated item of block.
+		std::vector<wdedup::ProfileBlock> blocks = 
+			wdedup::profileIndexSimple(filename, mode);
+		size_t first = 0;
+		for(size_t i = 0; i < blocks.size(); ++ i) {
+			size_t last = first + blocks[i].items - 1;
+			if(last % 2 != 0) -- last;
+			EXPECT_EQ(blocks[i].maxCount, counting? (last + 2) * (last + 2) : 0);
+			first += blocks[i].items;
+		}
+		EXPECT_EQ(first, items);
+	}
+}
+
+/**
+ * wprofile.unindexed: this file tests that the profile written without
+ * its sidecar files could still be read sequentially.
+ */
+TEST(wprofile, unindexed) {
+	static const char* filename = "wprofile.unindexed.temp";
+	wdedup::profileRemoveSimple(filename);	// Make sure absence of file.
+	wdedup::FileMode mode;
+	{
+		wdedup::ProfileOutputSimple output(filename, mode, false, false);
+		output.push(wdedup::ProfileItem("alpha"));
+		output.push(wdedup::ProfileItem("beta", 7));
+		output.close();
+	}
+	EXPECT_NE(access(wdedup::profileIndexPath(filename).c_str(), F_OK), 0);
+	EXPECT_NE(access(wdedup::profileFilterPath(filename).c_str(), F_OK), 0);
+
+	wdedup::ProfileInputSimple input(filename, mode);
+	ASSERT_FALSE(input.empty());
+	EXPECT_TRUE(input.pop().repeated);
+	ASSERT_FALSE(input.empty());
+	wdedup::ProfileItem item = input.pop();
+	EXPECT_EQ(item.word, "beta");
+	EXPECT_EQ(item.occur, 7);
+	EXPECT_TRUE(input.empty());
+	wdedup::profileRemoveSimple(filename);
 }
@@ -0,0 +1,90 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file tests/wpool.cpp
+ * @author Haoran Luo
+ * @brief wdedup thread pool tests.
+ *
+ * This file is unit test for wpool.cpp. See corresponding header 
+ * and source file for details.
+ */
+#include "gtest/gtest.h"
+#include "impl/wpool.hpp"
+#include <atomic>
+#include <stdexcept>
+
+/**
+ * wpool.group: this file tests that every task submitted to a task
+ * group has been run once waiting for the group returns, including
+ * the tasks submitted and waited inside other tasks.
+ */
+TEST(wpool, group) {
+	wdedup::ThreadPool pool(4);
+	ASSERT_EQ(pool.size(), 4);
+
+	// Submit tasks that submit and wait for their own tasks, which
+	// must not exhaust the workers of the pool.
+	std::atomic<size_t> counter(0);
+	wdedup::TaskGroup group(pool);
+	for(size_t i = 0; i < 64; ++ i) group.run([&]() {
+		wdedup::TaskGroup inner(pool);
+		for(size_t j = 0; j < 64; ++ j) 
+			inner.run([&]() { counter.fetch_add(1); });
+		inner.wait();
+	});
+	group.wait();
+	ASSERT_EQ(counter.load(), 64 * 64);
+}
+
+/**
+ * wpool.error: this file tests that the error raised by a task is
+ * rethrown by waiting for its group, after other tasks are done.
+ */
+TEST(wpool, error) {
+	wdedup::ThreadPool pool(2);
+	std::atomic<size_t> counter(0);
+	wdedup::TaskGroup group(pool);
+	for(size_t i = 0; i < 16; ++ i) group.run([&, i]() {
+		counter.fetch_add(1);
+		if(i == 7) throw std::runtime_error("task");
+	});
+	ASSERT_THROW(group.wait(), std::runtime_error);
+	ASSERT_EQ(counter.load(), 16);
+
+	// The group could be reused after the error is rethrown.
+	group.run([&]() { counter.fetch_add(1); });
+	group.wait();
+	ASSERT_EQ(counter.load(), 17);
+}
+
+/**
+ * wpool.single: this file tests that the pool with only the 
+ * constructing thread runs the tasks while waiting.
+ */
+TEST(wpool, single) {
+	wdedup::ThreadPool pool(1, true);
+	size_t counter = 0;
+	wdedup::TaskGroup group(pool);
+	for(size_t i = 0; i < 16; ++ i) group.run([&]() { ++ counter; });
+	group.wait();
+	ASSERT_EQ(counter, 16);
+}
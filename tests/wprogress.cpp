@@ -0,0 +1,122 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file tests/wprogress.cpp
+ * @author Haoran Luo
+ * @brief wdedup progress metrics tests.
+ *
+ * This file is unit test for wprogress.cpp. See corresponding header 
+ * and source file for details.
+ */
+#include "gtest/gtest.h"
+#include "impl/wprogress.hpp"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+// Retrieve the value of the metric from the rendered progress.
+static double value(const std::string& rendered, const std::string& name) {
+	std::stringstream lines(rendered);
+	std::string line;
+	while(std::getline(lines, line)) {
+		if(line.compare(0, name.size(), name) != 0) continue;
+		if(line.size() > name.size() && line[name.size()] != ' ' 
+			&& line[name.size()] != '{') continue;
+		return std::stod(line.substr(line.rfind(' ') + 1));
+	}
+	return -2.0;
+}
+
+/**
+ * wprogress.eta: this file tests that the remaining time of current 
+ * stage is estimated by the rate of work since the stage is seen, 
+ * by the bytes consumed when profiling and the cost when merging.
+ */
+TEST(wprogress, eta) {
+	wdedup::ProgressReport progress;
+	progress.stage("wprof");
+	progress.original(1000);
+	progress.consume(0);
+	std::string rendered = progress.render();
+	ASSERT_NE(rendered.find("wdedup_stage_info{stage=\"wprof\"} 1"), 
+		std::string::npos);
+	ASSERT_EQ(value(rendered, "wdedup_stage_eta_seconds"), -1.0);
+
+	// Half of the file consumed, so the remaining half takes as long.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	progress.consume(500);
+	rendered = progress.render();
+	ASSERT_EQ(value(rendered, "wdedup_original_consumed_bytes"), 500);
+	double eta = value(rendered, "wdedup_stage_eta_seconds");
+	ASSERT_GE(eta, 0.05); ASSERT_LE(eta, 1.0);
+
+	// The merges are measured by their cost once merging starts.
+	std::vector<wdedup::MergePlan> plans(4);
+	for(size_t i = 0; i < plans.size(); ++ i) plans[i].cost = 100;
+	progress.plan(plans);
+	progress.stage("wmerge");
+	rendered = progress.render();
+	ASSERT_EQ(value(rendered, "wdedup_merges_planned"), 4);
+	ASSERT_EQ(value(rendered, "wdedup_stage_eta_seconds"), -1.0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	progress.merged(plans[0]);
+	progress.merged(plans[1]);
+	progress.merged(plans[2]);
+	rendered = progress.render();
+	ASSERT_EQ(value(rendered, "wdedup_merges_done"), 3);
+	ASSERT_EQ(value(rendered, "wdedup_merge_cost_done_bytes"), 300);
+	eta = value(rendered, "wdedup_stage_eta_seconds");
+	ASSERT_GE(eta, 0.01); ASSERT_LE(eta, 0.5);
+}
+
+/**
+ * wprogress.export: this file tests that the textfile is written once
+ * the exporting starts, and replaced periodically without leaving the
+ * temporary file behind.
+ */
+TEST(wprogress, export) {
+	static const char* path = "wprogress.export.temp.prom";
+	unlink(path);
+	{
+		wdedup::ProgressReport progress;
+		progress.stage("wprof");
+		progress.start(path, std::chrono::milliseconds(10));
+		ASSERT_EQ(access(path, R_OK), 0);
+		progress.stage("wmerge");
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::ifstream file(path);
+		std::stringstream content; content << file.rdbuf();
+		ASSERT_NE(content.str().find("stage=\"wmerge\""), std::string::npos);
+		progress.stage("wlist");
+	}
+
+	// The progress is exported once more when it is destroyed.
+	std::ifstream file(path);
+	std::stringstream content; content << file.rdbuf();
+	ASSERT_NE(content.str().find("stage=\"wlist\""), std::string::npos);
+	ASSERT_NE(access((std::string(path) + ".tmp").c_str(), F_OK), 0);
+	ASSERT_THROW(wdedup::ProgressReport().start(
+		"wprogress.missing.temp/a.prom", wdedup::progressInterval),
+		wdedup::Error);
+	unlink(path);
+}
@@ -0,0 +1,76 @@
+/* Copyright © 2019 Haoran Luo
+ *
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the “Software”), to deal in the Software without 
+ * restriction, including without limitation the rights to use, 
+ * copy, modify, merge, publish, distribute, sublicense, and/or 
+ * sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR 
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+/**
+ * @file tests/wtrace.cpp
+ * @author Haoran Luo
+ * @brief wdedup timeline tracing tests.
+ *
+ * This file is unit test for wtrace.cpp. See corresponding header 
+ * and source file for details.
+ */
+#include "gtest/gtest.h"
+#include "impl/wtrace.hpp"
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Count the occurences of the pattern inside the string.
+static size_t occurences(const std::string& s, const std::string& pattern) {
+	size_t count = 0;
+	for(size_t i = s.find(pattern); i != std::string::npos; 
+		i = s.find(pattern, i + 1)) ++ count;
+	return count;
+}
+
+/**
+ * wtrace.record: this file tests that no span is recorded before the
+ * tracing is enabled, and spans recorded by multiple threads across 
+ * chunks are all written out, along with the names of the threads.
+ */
+TEST(wtrace, record) {
+	{ wdedup::TraceSpan span("disabled"); }
+	wdedup::traceStart();
+	ASSERT_TRUE(wdedup::traceEnabled());
+
+	// Record enough spans to fill several chunks on each thread.
+	static const size_t threads = 4;
+	static const size_t spans = wdedup::TraceChunk::capacity * 2 + 7;
+	std::vector<std::thread> workers;
+	for(size_t i = 0; i < threads; ++ i) workers.push_back(std::thread([]() {
+		for(size_t j = 0; j < spans; ++ j) wdedup::TraceSpan span("work", j);
+	}));
+	for(size_t i = 0; i < threads; ++ i) workers[i].join();
+
+	// A finished span is not recorded again on destruction.
+	{ wdedup::TraceSpan span("main", 42); span.finish(); }
+
+	std::stringstream out;
+	wdedup::traceWrite(out);
+	std::string trace = out.str();
+	ASSERT_EQ(occurences(trace, "\"name\": \"disabled\""), 0);
+	ASSERT_EQ(occurences(trace, "\"name\": \"work\""), threads * spans);
+	ASSERT_EQ(occurences(trace, "\"name\": \"main\""), 1);
+	ASSERT_EQ(occurences(trace, "\"thread_name\""), threads + 1);
+	ASSERT_EQ(trace.compare(0, 17, "{\"displayTimeUnit"), 0);
+	ASSERT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}